@@ -0,0 +1,497 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+/*
+ * Event throughput and latency benchmark
+ *
+ * Starts a private Xvfb, creates a grid of windows and floods them from a
+ * second X connection with XTest motion, key and button events and
+ * WM_DELETE_WINDOW client messages. Every injected event is matched to the
+ * ADL event it produces to measure the end to end latency through
+ * adlProcessEvent. Two phases are run:
+ *
+ *   latency    - one event in flight at a time
+ *   throughput - bursts of events with a bounded number in flight
+ *
+ * The results are printed to stdout as a single line of JSON.
+ *
+ * usage: adl-bench-events [-n events] [-l samples] [-w windows] [-b burst]
+ *                         [-d]
+ *
+ *   -d  use the X server in $DISPLAY instead of starting Xvfb
+ */
+
+#include <adl/adl.h>
+#include "xvfb.h"
+#include "stats.h"
+
+#include <xcb/xcb.h>
+#include <xcb/xtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+
+#define MAX_WINDOWS 16
+#define WINDOW_SIZE 128
+
+/* the injected sequence, each produces exactly one of these ADL events */
+static const ADLEventType cycle[] =
+{
+  ADL_EVENT_MOUSE_MOVE,
+  ADL_EVENT_KEY_DOWN,
+  ADL_EVENT_KEY_UP,
+  ADL_EVENT_MOUSE_DOWN,
+  ADL_EVENT_MOUSE_UP,
+  ADL_EVENT_CLOSE
+};
+
+#define CYCLE_LEN (sizeof(cycle) / sizeof(*cycle))
+
+typedef struct
+{
+  xcb_window_t id;
+  int          x, y;
+}
+Target;
+
+typedef struct
+{
+  ADLEventType type;
+  uint64_t     sentNS;
+}
+Sent;
+
+static struct
+{
+  xcb_connection_t * xcb;
+  xcb_window_t       root;
+  xcb_atom_t         wmProtocols;
+  xcb_atom_t         wmDelete;
+  Target             targets[MAX_WINDOWS];
+  unsigned int       targetCount;
+
+  /* the current phase */
+  Sent             * sent;
+  unsigned int       total;
+  unsigned int       burst;
+  unsigned int       inFlight;
+  atomic_uint        sentCount;
+  atomic_uint        recvCount;
+}
+bench;
+
+static xcb_atom_t internAtom(const char * name)
+{
+  xcb_intern_atom_reply_t * reply = xcb_intern_atom_reply(bench.xcb,
+      xcb_intern_atom(bench.xcb, false, strlen(name), name), NULL);
+  if (!reply)
+    return XCB_ATOM_NONE;
+
+  const xcb_atom_t atom = reply->atom;
+  free(reply);
+  return atom;
+}
+
+/* connect the injecting client and find the windows ADL created */
+static bool injectInit(unsigned int windows)
+{
+  bench.xcb = xcb_connect(NULL, NULL);
+  if (xcb_connection_has_error(bench.xcb))
+  {
+    fprintf(stderr, "failed to connect to the X server\n");
+    return false;
+  }
+
+  const xcb_query_extension_reply_t * ext =
+    xcb_get_extension_data(bench.xcb, &xcb_test_id);
+  if (!ext || !ext->present)
+  {
+    fprintf(stderr, "the X server does not support XTEST\n");
+    return false;
+  }
+
+  bench.root        = xcb_setup_roots_iterator(
+      xcb_get_setup(bench.xcb)).data->root;
+  bench.wmProtocols = internAtom("WM_PROTOCOLS"    );
+  bench.wmDelete    = internAtom("WM_DELETE_WINDOW");
+
+  xcb_query_tree_reply_t * tree = xcb_query_tree_reply(bench.xcb,
+      xcb_query_tree(bench.xcb, bench.root), NULL);
+  if (!tree)
+    return false;
+
+  const xcb_window_t * children = xcb_query_tree_children(tree);
+  const int            count    = xcb_query_tree_children_length(tree);
+
+  bench.targetCount = 0;
+  for(int i = 0; i < count && bench.targetCount < MAX_WINDOWS; ++i)
+  {
+    xcb_get_geometry_reply_t * geo = xcb_get_geometry_reply(bench.xcb,
+        xcb_get_geometry(bench.xcb, children[i]), NULL);
+    if (!geo)
+      continue;
+
+    if (geo->width == WINDOW_SIZE && geo->height == WINDOW_SIZE)
+    {
+      Target * t = &bench.targets[bench.targetCount++];
+      t->id = children[i];
+      t->x  = geo->x;
+      t->y  = geo->y;
+    }
+    free(geo);
+  }
+  free(tree);
+
+  if (bench.targetCount != windows)
+  {
+    fprintf(stderr, "found %u of %u windows\n", bench.targetCount, windows);
+    return false;
+  }
+
+  return true;
+}
+
+static void inject(unsigned int i)
+{
+  const Target * t = &bench.targets[(i / CYCLE_LEN) % bench.targetCount];
+
+  switch(cycle[i % CYCLE_LEN])
+  {
+    case ADL_EVENT_MOUSE_MOVE:
+      /* alternate the position so the pointer always moves */
+      xcb_test_fake_input(bench.xcb, XCB_MOTION_NOTIFY, 0, XCB_CURRENT_TIME,
+          bench.root, t->x + 16 + ((i / CYCLE_LEN) & 1), t->y + 16, 0);
+      break;
+
+    case ADL_EVENT_KEY_DOWN:
+      xcb_test_fake_input(bench.xcb, XCB_KEY_PRESS, 38, XCB_CURRENT_TIME,
+          XCB_NONE, 0, 0, 0);
+      break;
+
+    case ADL_EVENT_KEY_UP:
+      xcb_test_fake_input(bench.xcb, XCB_KEY_RELEASE, 38, XCB_CURRENT_TIME,
+          XCB_NONE, 0, 0, 0);
+      break;
+
+    case ADL_EVENT_MOUSE_DOWN:
+      xcb_test_fake_input(bench.xcb, XCB_BUTTON_PRESS, 1, XCB_CURRENT_TIME,
+          XCB_NONE, 0, 0, 0);
+      break;
+
+    case ADL_EVENT_MOUSE_UP:
+      xcb_test_fake_input(bench.xcb, XCB_BUTTON_RELEASE, 1, XCB_CURRENT_TIME,
+          XCB_NONE, 0, 0, 0);
+      break;
+
+    case ADL_EVENT_CLOSE:
+    {
+      const xcb_client_message_event_t xe =
+      {
+        .response_type = XCB_CLIENT_MESSAGE,
+        .format        = 32,
+        .window        = t->id,
+        .type          = bench.wmProtocols,
+        .data          = { .data32 = { bench.wmDelete, XCB_CURRENT_TIME } }
+      };
+      xcb_send_event(bench.xcb, false, t->id, XCB_EVENT_MASK_NO_EVENT,
+          (const char *)&xe);
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+static void * injectThread(ADLThread * thread, void * udata)
+{
+  while(adlThreadIsRunning(thread))
+  {
+    const unsigned int start = atomic_load(&bench.sentCount);
+    if (start == bench.total)
+      break;
+
+    /* bound the number of events queued in the X server and ADL */
+    if (start - atomic_load(&bench.recvCount) >= bench.inFlight)
+    {
+      sched_yield();
+      continue;
+    }
+
+    unsigned int end = start + bench.burst;
+    if (end > bench.total)
+      end = bench.total;
+
+    for(unsigned int i = start; i < end; ++i)
+      inject(i);
+
+    /* publish before the flush so the events are never seen unannounced */
+    const uint64_t now = adlGetClockNS();
+    for(unsigned int i = start; i < end; ++i)
+    {
+      bench.sent[i].type   = cycle[i % CYCLE_LEN];
+      bench.sent[i].sentNS = now;
+    }
+    atomic_store(&bench.sentCount, end);
+    xcb_flush(bench.xcb);
+  }
+
+  return NULL;
+}
+
+static bool runPhase(const char * name, unsigned int total, unsigned int burst,
+    unsigned int inFlight, bool last)
+{
+  total -= total % CYCLE_LEN;
+
+  bench.sent     = calloc(total, sizeof(*bench.sent));
+  bench.total    = total;
+  bench.burst    = burst;
+  bench.inFlight = inFlight;
+  atomic_store(&bench.sentCount, 0);
+  atomic_store(&bench.recvCount, 0);
+
+  uint64_t * latency = malloc(sizeof(*latency) * total);
+  if (!bench.sent || !latency)
+  {
+    fprintf(stderr, "out of memory\n");
+    free(bench.sent);
+    free(latency);
+    return false;
+  }
+
+  ADLThread thread;
+  const uint64_t start = adlGetClockNS();
+  if (adlThreadCreate(injectThread, NULL, &thread) != ADL_OK)
+  {
+    free(bench.sent);
+    free(latency);
+    return false;
+  }
+
+  unsigned int matched  = 0;
+  unsigned int lost     = 0;
+  unsigned int other    = 0;
+  unsigned int r        = 0;
+  uint64_t     progress = start;
+  bool         ok       = true;
+
+  while(r < total)
+  {
+    ADLEvent event;
+    if (adlProcessEvent(1, &event) != ADL_OK)
+    {
+      ok = false;
+      break;
+    }
+
+    const uint64_t now = adlGetClockNS();
+    switch(event.type)
+    {
+      case ADL_EVENT_NONE:
+        /* give up if the server stops delivering */
+        if (now - progress > 5000000000ULL)
+        {
+          lost += total - r;
+          r     = total;
+        }
+        continue;
+
+      case ADL_EVENT_MOUSE_MOVE:
+      case ADL_EVENT_KEY_DOWN:
+      case ADL_EVENT_KEY_UP:
+      case ADL_EVENT_MOUSE_DOWN:
+      case ADL_EVENT_MOUSE_UP:
+      case ADL_EVENT_CLOSE:
+        break;
+
+      default:
+        ++other;
+        continue;
+    }
+
+    /* events arrive in the order they were sent, anything skipped over was
+     * lost or merged by the server */
+    for(;;)
+    {
+      while(r >= atomic_load(&bench.sentCount))
+        sched_yield();
+
+      if (bench.sent[r].type == event.type)
+        break;
+
+      ++lost;
+      if (++r == total)
+        break;
+    }
+
+    if (r == total)
+      break;
+
+    latency[matched++] = now - bench.sent[r].sentNS;
+    atomic_store(&bench.recvCount, ++r);
+    progress = now;
+  }
+
+  const uint64_t elapsed = adlGetClockNS() - start;
+  adlThreadStop(&thread);
+  adlThreadJoin(&thread, NULL, -1);
+
+  statsSort(latency, matched);
+  const double seconds = elapsed / 1e9;
+
+  printf("\"%s\":{"
+      "\"events\":%u,\"lost\":%u,\"other\":%u,"
+      "\"seconds\":%.6f,\"events_per_sec\":%.1f,"
+      "\"p50_ns\":%" PRIu64 ",\"p90_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ","
+      "\"p999_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64 "}%s",
+      name, matched, lost, other, seconds,
+      seconds > 0 ? matched / seconds : 0.0,
+      statsPercentile(latency, matched, 0.50 ),
+      statsPercentile(latency, matched, 0.90 ),
+      statsPercentile(latency, matched, 0.99 ),
+      statsPercentile(latency, matched, 0.999),
+      matched ? latency[matched - 1] : 0,
+      last ? "" : ",");
+
+  free(bench.sent);
+  free(latency);
+  return ok;
+}
+
+/* wait for the windows to be mapped and discard the initial events */
+static bool waitMapped(unsigned int windows)
+{
+  unsigned int shown = 0;
+  uint64_t     until = adlGetClockNS() + 5000000000ULL;
+  ADLEvent     event;
+
+  while(adlGetClockNS() < until)
+  {
+    if (adlProcessEvent(10, &event) != ADL_OK)
+      return false;
+
+    if (event.type == ADL_EVENT_SHOW && ++shown == windows)
+      until = adlGetClockNS() + 100000000ULL;
+  }
+
+  return shown >= windows;
+}
+
+int main(int argc, char * argv[])
+{
+  unsigned int events  = 300000;
+  unsigned int samples = 30000;
+  unsigned int windows = 4;
+  unsigned int burst   = 64 * CYCLE_LEN;
+  bool         useXvfb = true;
+  int          retval  = -1;
+
+  int opt;
+  while((opt = getopt(argc, argv, "n:l:w:b:d")) != -1)
+    switch(opt)
+    {
+      case 'n': events  = strtoul(optarg, NULL, 10); break;
+      case 'l': samples = strtoul(optarg, NULL, 10); break;
+      case 'w': windows = strtoul(optarg, NULL, 10); break;
+      case 'b': burst   = strtoul(optarg, NULL, 10); break;
+      case 'd': useXvfb = false; break;
+      default:
+        fprintf(stderr, "usage: %s [-n events] [-l samples] [-w windows] "
+            "[-b burst] [-d]\n", argv[0]);
+        return -1;
+    }
+
+  if (windows < 1 || windows > MAX_WINDOWS || burst < 1)
+  {
+    fprintf(stderr, "windows must be 1-%d and burst at least 1\n",
+        MAX_WINDOWS);
+    return -1;
+  }
+
+  if (useXvfb && !xvfbStart())
+    return -1;
+
+  /* keep stdout for the results */
+  ADLSetLogHandlersMask(adlLogHandlers, ~ADL_LOG_INFO);
+
+  if (adlInitialize() != ADL_OK)
+    goto err_xvfb;
+
+  {
+    int count;
+    adlGetPlatformList(&count, NULL);
+
+    const char * platforms[count];
+    adlGetPlatformList(&count, platforms);
+
+    if (adlUsePlatform(platforms[0]) != ADL_OK)
+      goto err_xvfb;
+  }
+
+  for(unsigned int i = 0; i < windows; ++i)
+  {
+    ADLWindowDef def =
+    {
+      .title      = "ADL Event Bench",
+      .className  = "adl-bench",
+      .type       = ADL_WINDOW_TYPE_NORMAL,
+      .borderless = true,
+      .x          = (i % 4) * (WINDOW_SIZE + 8),
+      .y          = (i / 4) * (WINDOW_SIZE + 8),
+      .w          = WINDOW_SIZE,
+      .h          = WINDOW_SIZE
+    };
+
+    ADLWindow * window;
+    if (adlWindowCreate(def, &window) != ADL_OK)
+      goto err_shutdown;
+    adlWindowShow(window);
+  }
+  adlFlush();
+
+  if (!waitMapped(windows) || !injectInit(windows))
+    goto err_inject;
+
+  printf("{\"bench\":\"events\",\"windows\":%u,\"burst\":%u,", windows, burst);
+  if (runPhase("latency"   , samples, 1    , 1         , false) &&
+      runPhase("throughput", events , burst, burst * 4 , true ))
+    retval = 0;
+  printf("}\n");
+
+err_inject:
+  if (bench.xcb)
+    xcb_disconnect(bench.xcb);
+err_shutdown:
+  adlShutdown();
+err_xvfb:
+  xvfbStop();
+  return retval;
+}
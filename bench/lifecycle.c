@@ -0,0 +1,501 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+/*
+ * Window and image lifecycle stress benchmark
+ *
+ * Starts a private Xvfb and repeatedly creates, maps and destroys windows
+ * nested up to the given depth under a container window, each with cursor
+ * images. The latency of every create and destroy call is recorded, RSS and
+ * the X resources owned by the ADL connection (via the X-Resource extension)
+ * are sampled after the first round and at the end to expose leaks.
+ *
+ * The results are printed to stdout as a single line of JSON.
+ *
+ * usage: adl-bench-lifecycle [-r rounds] [-w windows] [-i images] [-n depth]
+ *                            [-d]
+ *
+ *   -d  use the X server in $DISPLAY instead of starting Xvfb
+ */
+
+#include <adl/adl.h>
+#include "xvfb.h"
+#include "stats.h"
+
+#include <xcb/xcb.h>
+#include <xcb/res.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#define CONTAINER_W 640
+#define CONTAINER_H 480
+#define CURSOR_SIZE 32
+#define MAX_LEAKS   16
+
+typedef struct
+{
+  const char * name;
+  uint64_t   * samples;
+  unsigned int count;
+}
+Op;
+
+enum
+{
+  OP_WINDOW_CREATE,
+  OP_WINDOW_DESTROY,
+  OP_IMAGE_CREATE,
+  OP_IMAGE_DESTROY,
+  OP_COUNT
+};
+
+static Op ops[OP_COUNT] =
+{
+  [OP_WINDOW_CREATE ] = { .name = "window_create"  },
+  [OP_WINDOW_DESTROY] = { .name = "window_destroy" },
+  [OP_IMAGE_CREATE  ] = { .name = "image_create"   },
+  [OP_IMAGE_DESTROY ] = { .name = "image_destroy"  }
+};
+
+typedef struct
+{
+  xcb_atom_t type;
+  uint32_t   count;
+}
+ResCount;
+
+typedef struct
+{
+  unsigned int typeCount;
+  ResCount     types[MAX_LEAKS];
+  uint64_t     total;
+  uint64_t     pixmapBytes;
+}
+ResSnapshot;
+
+static struct
+{
+  xcb_connection_t * xcb;
+  uint32_t           client; // XID of the ADL connection for XRes
+}
+res;
+
+static uint32_t pixels[CURSOR_SIZE * CURSOR_SIZE];
+
+#define TIMED(op, x) \
+  ({ \
+    const uint64_t __start = adlGetClockNS(); \
+    ADL_STATUS __status = (x); \
+    ops[op].samples[ops[op].count++] = adlGetClockNS() - __start; \
+    __status; \
+  })
+
+static uint64_t getRSSKB(void)
+{
+  FILE * fp = fopen("/proc/self/statm", "r");
+  if (!fp)
+    return 0;
+
+  unsigned long size, resident = 0;
+  if (fscanf(fp, "%lu %lu", &size, &resident) != 2)
+    resident = 0;
+  fclose(fp);
+
+  return (uint64_t)resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+/* find the client that owns the container window, ADL doesn't expose its X
+ * ids so locate the window by its unique size */
+static bool resInit(void)
+{
+  res.xcb = xcb_connect(NULL, NULL);
+  if (xcb_connection_has_error(res.xcb))
+  {
+    fprintf(stderr, "failed to connect to the X server\n");
+    return false;
+  }
+
+  const xcb_query_extension_reply_t * ext =
+    xcb_get_extension_data(res.xcb, &xcb_res_id);
+  if (!ext || !ext->present)
+  {
+    fprintf(stderr, "the X server does not support X-Resource\n");
+    return false;
+  }
+
+  const xcb_window_t root =
+    xcb_setup_roots_iterator(xcb_get_setup(res.xcb)).data->root;
+
+  xcb_query_tree_reply_t * tree = xcb_query_tree_reply(res.xcb,
+      xcb_query_tree(res.xcb, root), NULL);
+  if (!tree)
+    return false;
+
+  const xcb_window_t * children = xcb_query_tree_children(tree);
+  const int            count    = xcb_query_tree_children_length(tree);
+
+  xcb_window_t container = XCB_NONE;
+  for(int i = 0; i < count && container == XCB_NONE; ++i)
+  {
+    xcb_get_geometry_reply_t * geo = xcb_get_geometry_reply(res.xcb,
+        xcb_get_geometry(res.xcb, children[i]), NULL);
+    if (!geo)
+      continue;
+
+    if (geo->width == CONTAINER_W && geo->height == CONTAINER_H)
+      container = children[i];
+    free(geo);
+  }
+  free(tree);
+
+  xcb_res_query_clients_reply_t * clients = xcb_res_query_clients_reply(
+      res.xcb, xcb_res_query_clients(res.xcb), NULL);
+  if (!clients)
+    return false;
+
+  xcb_res_client_iterator_t it =
+    xcb_res_query_clients_clients_iterator(clients);
+  for(; it.rem; xcb_res_client_next(&it))
+    if ((container & ~it.data->resource_mask) == it.data->resource_base)
+    {
+      res.client = it.data->resource_base;
+      break;
+    }
+  free(clients);
+
+  if (container == XCB_NONE || !res.client)
+  {
+    fprintf(stderr, "unable to find the ADL X client\n");
+    return false;
+  }
+
+  return true;
+}
+
+static void resSnapshot(ResSnapshot * snap)
+{
+  memset(snap, 0, sizeof(*snap));
+
+  xcb_res_query_client_resources_reply_t * reply =
+    xcb_res_query_client_resources_reply(res.xcb,
+        xcb_res_query_client_resources(res.xcb, res.client), NULL);
+  if (reply)
+  {
+    xcb_res_type_iterator_t it =
+      xcb_res_query_client_resources_types_iterator(reply);
+    for(; it.rem; xcb_res_type_next(&it))
+    {
+      snap->total += it.data->count;
+      if (snap->typeCount < MAX_LEAKS)
+      {
+        snap->types[snap->typeCount].type  = it.data->resource_type;
+        snap->types[snap->typeCount].count = it.data->count;
+        ++snap->typeCount;
+      }
+    }
+    free(reply);
+  }
+
+  xcb_res_query_client_pixmap_bytes_reply_t * bytes =
+    xcb_res_query_client_pixmap_bytes_reply(res.xcb,
+        xcb_res_query_client_pixmap_bytes(res.xcb, res.client), NULL);
+  if (bytes)
+  {
+    snap->pixmapBytes = bytes->bytes;
+    free(bytes);
+  }
+}
+
+static uint32_t resFind(const ResSnapshot * snap, xcb_atom_t type)
+{
+  for(unsigned int i = 0; i < snap->typeCount; ++i)
+    if (snap->types[i].type == type)
+      return snap->types[i].count;
+  return 0;
+}
+
+/* print the resource types that grew between the snapshots */
+static void printLeaks(const ResSnapshot * before, const ResSnapshot * after)
+{
+  bool first = true;
+  printf("\"x_leaks\":{");
+  for(unsigned int i = 0; i < after->typeCount; ++i)
+  {
+    const uint32_t was = resFind(before, after->types[i].type);
+    if (after->types[i].count <= was)
+      continue;
+
+    xcb_get_atom_name_reply_t * name = xcb_get_atom_name_reply(res.xcb,
+        xcb_get_atom_name(res.xcb, after->types[i].type), NULL);
+    if (!name)
+      continue;
+
+    printf("%s\"%.*s\":%" PRIu32, first ? "" : ",",
+        xcb_get_atom_name_name_length(name), xcb_get_atom_name_name(name),
+        after->types[i].count - was);
+    first = false;
+    free(name);
+  }
+  printf("}");
+}
+
+static void drainEvents(void)
+{
+  ADLEvent event;
+  while(adlProcessEvent(0, &event) == ADL_OK && event.type != ADL_EVENT_NONE)
+    continue;
+}
+
+static bool runRound(ADLWindow * container, unsigned int windows,
+    unsigned int images, unsigned int depth)
+{
+  ADLWindow * win[windows];
+  ADLImage  * img[windows * images];
+
+  const ADLImageDef imgDef =
+  {
+    .backend  = ADL_IMAGE_BACKEND_BUFFER,
+    .format   = ADL_IMAGE_FORMAT_BGRA,
+    .bpp      = 32,
+    .depth    = 32,
+    .pitch    = CURSOR_SIZE * 4,
+    .w        = CURSOR_SIZE,
+    .h        = CURSOR_SIZE,
+    .u.buffer = pixels
+  };
+
+  for(unsigned int i = 0; i < windows; ++i)
+  {
+    /* chain windows into trees of `depth` levels under the container */
+    const ADLWindowDef def =
+    {
+      .parent     = i % depth ? win[i - 1] : container,
+      .title      = "ADL Lifecycle Bench",
+      .className  = "adl-bench",
+      .type       = ADL_WINDOW_TYPE_NORMAL,
+      .borderless = true,
+      .x          = (i * 7) % (CONTAINER_W / 2),
+      .y          = (i * 5) % (CONTAINER_H / 2),
+      .w          = 64,
+      .h          = 64
+    };
+
+    if (TIMED(OP_WINDOW_CREATE, adlWindowCreate(def, &win[i])) != ADL_OK)
+      return false;
+
+    for(unsigned int j = 0; j < images; ++j)
+      if (TIMED(OP_IMAGE_CREATE, adlImageCreate(win[i], imgDef,
+              &img[i * images + j])) != ADL_OK)
+        return false;
+
+    if (images)
+      adlPointerSetCursor(win[i], img[i * images], NULL, 0, 0);
+    adlWindowShow(win[i]);
+  }
+  adlFlush();
+  drainEvents();
+
+  for(unsigned int i = windows * images; i > 0; --i)
+    TIMED(OP_IMAGE_DESTROY, adlImageDestroy(&img[i - 1]));
+
+  /* children first */
+  for(unsigned int i = windows; i > 0; --i)
+    TIMED(OP_WINDOW_DESTROY, adlWindowDestroy(&win[i - 1]));
+
+  adlFlush();
+  drainEvents();
+  return true;
+}
+
+static void printOp(const Op * op)
+{
+  statsSort(op->samples, op->count);
+  printf("\"%s\":{\"count\":%u,"
+      "\"p50_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ",\"p999_ns\":%" PRIu64 ","
+      "\"max_ns\":%" PRIu64 "},",
+      op->name, op->count,
+      statsPercentile(op->samples, op->count, 0.50 ),
+      statsPercentile(op->samples, op->count, 0.99 ),
+      statsPercentile(op->samples, op->count, 0.999),
+      op->count ? op->samples[op->count - 1] : 0);
+}
+
+int main(int argc, char * argv[])
+{
+  unsigned int rounds  = 200;
+  unsigned int windows = 32;
+  unsigned int images  = 2;
+  unsigned int depth   = 4;
+  bool         useXvfb = true;
+  int          retval  = -1;
+
+  int opt;
+  while((opt = getopt(argc, argv, "r:w:i:n:d")) != -1)
+    switch(opt)
+    {
+      case 'r': rounds  = strtoul(optarg, NULL, 10); break;
+      case 'w': windows = strtoul(optarg, NULL, 10); break;
+      case 'i': images  = strtoul(optarg, NULL, 10); break;
+      case 'n': depth   = strtoul(optarg, NULL, 10); break;
+      case 'd': useXvfb = false; break;
+      default:
+        fprintf(stderr, "usage: %s [-r rounds] [-w windows] [-i images] "
+            "[-n depth] [-d]\n", argv[0]);
+        return -1;
+    }
+
+  if (rounds < 2 || windows < 1 || depth < 1)
+  {
+    fprintf(stderr, "at least 2 rounds, 1 window and a depth of 1 are "
+        "required\n");
+    return -1;
+  }
+
+  const unsigned int perOp[OP_COUNT] =
+  {
+    [OP_WINDOW_CREATE ] = rounds * windows,
+    [OP_WINDOW_DESTROY] = rounds * windows,
+    [OP_IMAGE_CREATE  ] = rounds * windows * images,
+    [OP_IMAGE_DESTROY ] = rounds * windows * images
+  };
+
+  for(int i = 0; i < OP_COUNT; ++i)
+    if (!(ops[i].samples = malloc(sizeof(uint64_t) * (perOp[i] + 1))))
+    {
+      fprintf(stderr, "out of memory\n");
+      return -1;
+    }
+
+  const uint64_t rssStart = getRSSKB();
+
+  if (useXvfb && !xvfbStart())
+    goto err_xvfb;
+
+  /* keep stdout for the results */
+  ADLSetLogHandlersMask(adlLogHandlers, ~ADL_LOG_INFO);
+
+  if (adlInitialize() != ADL_OK)
+    goto err_xvfb;
+
+  {
+    int count;
+    adlGetPlatformList(&count, NULL);
+
+    const char * platforms[count];
+    adlGetPlatformList(&count, platforms);
+
+    if (adlUsePlatform(platforms[0]) != ADL_OK)
+      goto err_xvfb;
+  }
+
+  const ADLWindowDef containerDef =
+  {
+    .title      = "ADL Lifecycle Bench",
+    .className  = "adl-bench",
+    .type       = ADL_WINDOW_TYPE_NORMAL,
+    .borderless = true,
+    .w          = CONTAINER_W,
+    .h          = CONTAINER_H
+  };
+
+  ADLWindow * container;
+  if (adlWindowCreate(containerDef, &container) != ADL_OK)
+    goto err_shutdown;
+  adlWindowShow(container);
+  adlFlush();
+
+  /* make sure the server has the container before looking for it */
+  {
+    ADLEvent event;
+    const uint64_t until = adlGetClockNS() + 5000000000ULL;
+    do
+      if (adlProcessEvent(10, &event) != ADL_OK)
+        goto err_shutdown;
+    while(event.type != ADL_EVENT_SHOW && adlGetClockNS() < until);
+  }
+
+  if (!resInit())
+    goto err_res;
+
+  /* the first round warms up the allocators and the server */
+  if (!runRound(container, windows, images, depth))
+    goto err_res;
+
+  ResSnapshot resWarm, resEnd;
+  resSnapshot(&resWarm);
+  const uint64_t rssWarm = getRSSKB();
+
+  const uint64_t start = adlGetClockNS();
+  for(unsigned int r = 1; r < rounds; ++r)
+    if (!runRound(container, windows, images, depth))
+      goto err_res;
+  const double seconds = (adlGetClockNS() - start) / 1e9;
+
+  resSnapshot(&resEnd);
+  const uint64_t rssEnd = getRSSKB();
+
+  ADLAllocStats winAlloc, imgAlloc;
+  adlGetAllocStats(&winAlloc, &imgAlloc);
+
+  printf("{\"bench\":\"lifecycle\",\"rounds\":%u,\"windows\":%u,"
+      "\"images\":%u,\"depth\":%u,\"seconds\":%.6f,"
+      "\"windows_per_sec\":%.1f,\"images_per_sec\":%.1f,",
+      rounds, windows, images, depth, seconds,
+      (rounds - 1) * windows / seconds,
+      (rounds - 1) * windows * images / seconds);
+
+  for(int i = 0; i < OP_COUNT; ++i)
+    printOp(&ops[i]);
+
+  printf("\"rss_start_kb\":%" PRIu64 ",\"rss_warm_kb\":%" PRIu64 ","
+      "\"rss_end_kb\":%" PRIu64 ",\"rss_growth_kb\":%" PRId64 ","
+      "\"heap_chunks\":%" PRIu64 ","
+      "\"x_resources_warm\":%" PRIu64 ",\"x_resources_end\":%" PRIu64 ","
+      "\"x_pixmap_bytes_warm\":%" PRIu64 ",\"x_pixmap_bytes_end\":%" PRIu64
+      ",",
+      rssStart, rssWarm, rssEnd, (int64_t)(rssEnd - rssWarm),
+      winAlloc.chunks + imgAlloc.chunks,
+      resWarm.total, resEnd.total,
+      resWarm.pixmapBytes, resEnd.pixmapBytes);
+
+  printLeaks(&resWarm, &resEnd);
+  printf("}\n");
+  retval = 0;
+
+err_res:
+  if (res.xcb)
+    xcb_disconnect(res.xcb);
+err_shutdown:
+  adlShutdown();
+err_xvfb:
+  xvfbStop();
+  for(int i = 0; i < OP_COUNT; ++i)
+    free(ops[i].samples);
+  return retval;
+}
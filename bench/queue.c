@@ -0,0 +1,527 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+/*
+ * Queue microbenchmark
+ *
+ * Compares the lock-free SPSC and MPMC queues, spinning on a full or empty
+ * queue and blocking in the *Wait functions, against a mutex and condition
+ * variable ring buffer. Throughput is measured with the given number of
+ * producers and consumers (the SPSC queue always uses one of each), and the
+ * handoff latency by bouncing a timestamp between two threads through a pair
+ * of queues. Finally timed waits on an empty queue and on the adl/sync.h
+ * primitives are checked to block for their timeout, the run fails if one
+ * returns early or far too late.
+ *
+ * The results are printed to stdout as a single line of JSON.
+ *
+ * usage: adl-bench-queue [-n items] [-l samples] [-c capacity]
+ *                        [-p producers] [-q consumers]
+ */
+
+#include <adl/adl.h>
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#define MAX_THREADS 64
+
+/* the timed wait check, a wait may overshoot by up to TIMED_WAIT_SLACK_NS */
+#define TIMED_WAIT_NS       20000000LL
+#define TIMED_WAIT_SLACK_NS 50000000LL
+
+typedef struct
+{
+  uint64_t seq;
+  uint64_t stamp;
+}
+Item;
+
+typedef struct
+{
+  const char * name;
+  bool         single; // one producer and one consumer only
+  void * (*create )(unsigned int capacity);
+  void   (*destroy)(void * queue);
+  void   (*push   )(void * queue, const Item * item);
+  void   (*pop    )(void * queue, Item * item);
+}
+Kind;
+
+/* the baseline, a ring buffer under a mutex */
+typedef struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t  notEmpty;
+  pthread_cond_t  notFull;
+  Item          * items;
+  unsigned int    capacity, head, count;
+}
+MutexQueue;
+
+static void * mutexCreate(unsigned int capacity)
+{
+  MutexQueue * q = calloc(1, sizeof(*q));
+  if (!q || !(q->items = malloc(capacity * sizeof(*q->items))))
+  {
+    free(q);
+    return NULL;
+  }
+
+  pthread_mutex_init(&q->lock    , NULL);
+  pthread_cond_init (&q->notEmpty, NULL);
+  pthread_cond_init (&q->notFull , NULL);
+  q->capacity = capacity;
+  return q;
+}
+
+static void mutexDestroy(void * queue)
+{
+  MutexQueue * q = (MutexQueue *)queue;
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy (&q->notEmpty);
+  pthread_cond_destroy (&q->notFull);
+  free(q->items);
+  free(q);
+}
+
+static void mutexPush(void * queue, const Item * item)
+{
+  MutexQueue * q = (MutexQueue *)queue;
+  pthread_mutex_lock(&q->lock);
+  while(q->count == q->capacity)
+    pthread_cond_wait(&q->notFull, &q->lock);
+  q->items[(q->head + q->count++) % q->capacity] = *item;
+  pthread_cond_signal(&q->notEmpty);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static void mutexPop(void * queue, Item * item)
+{
+  MutexQueue * q = (MutexQueue *)queue;
+  pthread_mutex_lock(&q->lock);
+  while(q->count == 0)
+    pthread_cond_wait(&q->notEmpty, &q->lock);
+  *item   = q->items[q->head];
+  q->head = (q->head + 1) % q->capacity;
+  --q->count;
+  pthread_cond_signal(&q->notFull);
+  pthread_mutex_unlock(&q->lock);
+}
+
+#define QUEUE_KIND(type, flags) \
+  static void * type##Create(unsigned int capacity) \
+  { \
+    ADL##type * q = aligned_alloc(ADL_CACHE_LINE, sizeof(*q)); \
+    if (q && adl##type##Init(q, capacity, sizeof(Item), flags) != ADL_OK) \
+    { \
+      free(q); \
+      return NULL; \
+    } \
+    return q; \
+  } \
+  static void type##Destroy(void * queue) \
+  { \
+    adl##type##Free((ADL##type *)queue); \
+    free(queue); \
+  }
+
+QUEUE_KIND(SPSCQueue, ADL_QUEUE_BLOCKING)
+QUEUE_KIND(MPMCQueue, ADL_QUEUE_BLOCKING)
+
+static void spscSpinPush(void * queue, const Item * item)
+{
+  while(!adlSPSCQueuePush((ADLSPSCQueue *)queue, item))
+    adlCPURelax();
+}
+
+static void spscSpinPop(void * queue, Item * item)
+{
+  while(!adlSPSCQueuePop((ADLSPSCQueue *)queue, item))
+    adlCPURelax();
+}
+
+static void spscWaitPush(void * queue, const Item * item)
+{
+  adlSPSCQueuePushWait((ADLSPSCQueue *)queue, item, -1);
+}
+
+static void spscWaitPop(void * queue, Item * item)
+{
+  adlSPSCQueuePopWait((ADLSPSCQueue *)queue, item, -1);
+}
+
+static void mpmcSpinPush(void * queue, const Item * item)
+{
+  while(!adlMPMCQueuePush((ADLMPMCQueue *)queue, item))
+    adlCPURelax();
+}
+
+static void mpmcSpinPop(void * queue, Item * item)
+{
+  while(!adlMPMCQueuePop((ADLMPMCQueue *)queue, item))
+    adlCPURelax();
+}
+
+static void mpmcWaitPush(void * queue, const Item * item)
+{
+  adlMPMCQueuePushWait((ADLMPMCQueue *)queue, item, -1);
+}
+
+static void mpmcWaitPop(void * queue, Item * item)
+{
+  adlMPMCQueuePopWait((ADLMPMCQueue *)queue, item, -1);
+}
+
+static const Kind kinds[] =
+{
+  { "spsc_spin", true , SPSCQueueCreate, SPSCQueueDestroy, spscSpinPush, spscSpinPop },
+  { "spsc_wait", true , SPSCQueueCreate, SPSCQueueDestroy, spscWaitPush, spscWaitPop },
+  { "mpmc_spin", false, MPMCQueueCreate, MPMCQueueDestroy, mpmcSpinPush, mpmcSpinPop },
+  { "mpmc_wait", false, MPMCQueueCreate, MPMCQueueDestroy, mpmcWaitPush, mpmcWaitPop },
+  { "mutex"    , false, mutexCreate    , mutexDestroy    , mutexPush   , mutexPop    }
+};
+
+#define KIND_COUNT (sizeof(kinds) / sizeof(*kinds))
+
+typedef struct
+{
+  const Kind * kind;
+  void       * queue;
+  void       * reply; // the return queue for the latency test
+  unsigned int first, count;
+  uint64_t     sum;
+}
+Worker;
+
+static atomic_bool go;
+
+static void waitGo(void)
+{
+  while(!atomic_load(&go))
+    adlCPURelax();
+}
+
+static void * producerThread(ADLThread * thread, void * udata)
+{
+  Worker * w = (Worker *)udata;
+  waitGo();
+  for(unsigned int i = 0; i < w->count; ++i)
+  {
+    const Item item = { .seq = w->first + i };
+    w->kind->push(w->queue, &item);
+  }
+  return NULL;
+}
+
+static void * consumerThread(ADLThread * thread, void * udata)
+{
+  Worker * w = (Worker *)udata;
+  Item item;
+  waitGo();
+  for(unsigned int i = 0; i < w->count; ++i)
+  {
+    w->kind->pop(w->queue, &item);
+    w->sum += item.seq;
+  }
+  return NULL;
+}
+
+static void * echoThread(ADLThread * thread, void * udata)
+{
+  Worker * w = (Worker *)udata;
+  Item item;
+  for(unsigned int i = 0; i < w->count; ++i)
+  {
+    w->kind->pop (w->queue, &item);
+    w->kind->push(w->reply, &item);
+  }
+  return NULL;
+}
+
+/* split `total` items over `n` workers */
+static void split(Worker * w, unsigned int n, unsigned int total)
+{
+  unsigned int first = 0;
+  for(unsigned int i = 0; i < n; ++i)
+  {
+    w[i].first = first;
+    w[i].count = total / n + (i < total % n ? 1 : 0);
+    first += w[i].count;
+  }
+}
+
+static bool runThroughput(const Kind * kind, unsigned int items,
+    unsigned int capacity, unsigned int producers, unsigned int consumers,
+    bool last)
+{
+  if (kind->single)
+    producers = consumers = 1;
+
+  void * queue = kind->create(capacity);
+  if (!queue)
+    return false;
+
+  Worker    prod[producers], cons[consumers];
+  ADLThread prodThread[producers], consThread[consumers];
+  memset(prod, 0, sizeof(prod));
+  memset(cons, 0, sizeof(cons));
+
+  split(prod, producers, items);
+  split(cons, consumers, items);
+
+  atomic_store(&go, false);
+  for(unsigned int i = 0; i < producers; ++i)
+  {
+    prod[i].kind  = kind;
+    prod[i].queue = queue;
+    adlThreadCreate(producerThread, &prod[i], &prodThread[i]);
+  }
+
+  for(unsigned int i = 0; i < consumers; ++i)
+  {
+    cons[i].kind  = kind;
+    cons[i].queue = queue;
+    adlThreadCreate(consumerThread, &cons[i], &consThread[i]);
+  }
+
+  const uint64_t start = adlGetClockNS();
+  atomic_store(&go, true);
+
+  for(unsigned int i = 0; i < producers; ++i)
+    adlThreadJoin(&prodThread[i], NULL, -1);
+
+  uint64_t sum = 0;
+  for(unsigned int i = 0; i < consumers; ++i)
+  {
+    adlThreadJoin(&consThread[i], NULL, -1);
+    sum += cons[i].sum;
+  }
+
+  const uint64_t elapsed = adlGetClockNS() - start;
+  const double   seconds = elapsed / 1e9;
+  const bool     ok      = sum == (uint64_t)items * (items - 1) / 2;
+  kind->destroy(queue);
+
+  printf("\"%s\":{\"producers\":%u,\"consumers\":%u,\"seconds\":%.6f,"
+      "\"items_per_sec\":%.1f,\"ok\":%s}%s",
+      kind->name, producers, consumers, seconds,
+      seconds > 0 ? items / seconds : 0.0,
+      ok ? "true" : "false",
+      last ? "" : ",");
+
+  return ok;
+}
+
+static bool runLatency(const Kind * kind, unsigned int samples, bool last)
+{
+  void     * queue   = kind->create(2);
+  void     * reply   = kind->create(2);
+  uint64_t * latency = malloc(samples * sizeof(*latency));
+  bool       ok      = false;
+
+  if (!queue || !reply || !latency)
+    goto out;
+
+  Worker echo =
+  {
+    .kind  = kind,
+    .queue = queue,
+    .reply = reply,
+    .count = samples
+  };
+
+  ADLThread thread;
+  if (adlThreadCreate(echoThread, &echo, &thread) != ADL_OK)
+    goto out;
+
+  for(unsigned int i = 0; i < samples; ++i)
+  {
+    Item item = { .seq = i, .stamp = adlGetClockNS() };
+    kind->push(queue, &item);
+    kind->pop (reply, &item);
+    latency[i] = adlGetClockNS() - item.stamp;
+  }
+  adlThreadJoin(&thread, NULL, -1);
+
+  statsSort(latency, samples);
+  printf("\"%s\":{\"samples\":%u,"
+      "\"p50_ns\":%" PRIu64 ",\"p90_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ","
+      "\"max_ns\":%" PRIu64 "}%s",
+      kind->name, samples,
+      statsPercentile(latency, samples, 0.50),
+      statsPercentile(latency, samples, 0.90),
+      statsPercentile(latency, samples, 0.99),
+      latency[samples - 1],
+      last ? "" : ",");
+  ok = true;
+
+out:
+  free(latency);
+  if (reply)
+    kind->destroy(reply);
+  if (queue)
+    kind->destroy(queue);
+  return ok;
+}
+
+/* a wait that can't succeed must return ADL_ERR_TIMEOUT after its timeout */
+static bool checkTimedWait(const char * name, ADL_STATUS (*wait)(void *),
+    void * udata, bool last)
+{
+  const uint64_t   start   = adlGetClockNS();
+  const ADL_STATUS status  = wait(udata);
+  const uint64_t   elapsed = adlGetClockNS() - start;
+
+  const bool ok = status == ADL_ERR_TIMEOUT &&
+    elapsed >= TIMED_WAIT_NS && elapsed <= TIMED_WAIT_NS + TIMED_WAIT_SLACK_NS;
+
+  printf("\"%s\":{\"status\":\"%s\",\"elapsed_ns\":%" PRIu64 ","
+      "\"ok\":%s}%s",
+      name, adlStatusString(status), elapsed, ok ? "true" : "false",
+      last ? "" : ",");
+  return ok;
+}
+
+static ADL_STATUS spscTimedPop(void * queue)
+{
+  Item item;
+  return adlSPSCQueuePopWait(queue, &item, TIMED_WAIT_NS);
+}
+
+static ADL_STATUS mpmcTimedPop(void * queue)
+{
+  Item item;
+  return adlMPMCQueuePopWait(queue, &item, TIMED_WAIT_NS);
+}
+
+static ADL_STATUS semaphoreTimedWait(void * sem)
+{
+  return adlSemaphoreWaitNS(sem, TIMED_WAIT_NS);
+}
+
+static ADL_STATUS signalTimedWait(void * signal)
+{
+  return adlSignalWaitNS(signal, TIMED_WAIT_NS);
+}
+
+static ADL_STATUS latchTimedWait(void * latch)
+{
+  return adlLatchWaitNS(latch, TIMED_WAIT_NS);
+}
+
+static bool runTimedWait(void)
+{
+  ADLSPSCQueue spsc;
+  ADLMPMCQueue mpmc;
+  if (adlSPSCQueueInit(&spsc, 2, sizeof(Item), ADL_QUEUE_BLOCKING) != ADL_OK)
+    return false;
+
+  if (adlMPMCQueueInit(&mpmc, 2, sizeof(Item), ADL_QUEUE_BLOCKING) != ADL_OK)
+  {
+    adlSPSCQueueFree(&spsc);
+    return false;
+  }
+
+  ADLSemaphore sem;
+  ADLSignal    signal;
+  ADLLatch     latch;
+  adlSemaphoreInit(&sem, 0);
+  adlSignalInit(&signal, false, false);
+  adlLatchInit(&latch, 1);
+
+  bool ok = true;
+  ok &= checkTimedWait("spsc_pop" , spscTimedPop      , &spsc  , false);
+  ok &= checkTimedWait("mpmc_pop" , mpmcTimedPop      , &mpmc  , false);
+  ok &= checkTimedWait("semaphore", semaphoreTimedWait, &sem   , false);
+  ok &= checkTimedWait("signal"   , signalTimedWait   , &signal, false);
+  ok &= checkTimedWait("latch"    , latchTimedWait    , &latch , true );
+
+  adlMPMCQueueFree(&mpmc);
+  adlSPSCQueueFree(&spsc);
+  return ok;
+}
+
+int main(int argc, char * argv[])
+{
+  unsigned int items     = 2000000;
+  unsigned int samples   = 20000;
+  unsigned int capacity  = 1024;
+  unsigned int producers = 2;
+  unsigned int consumers = 2;
+  bool         ok        = true;
+
+  int opt;
+  while((opt = getopt(argc, argv, "n:l:c:p:q:")) != -1)
+    switch(opt)
+    {
+      case 'n': items     = strtoul(optarg, NULL, 10); break;
+      case 'l': samples   = strtoul(optarg, NULL, 10); break;
+      case 'c': capacity  = strtoul(optarg, NULL, 10); break;
+      case 'p': producers = strtoul(optarg, NULL, 10); break;
+      case 'q': consumers = strtoul(optarg, NULL, 10); break;
+      default:
+        fprintf(stderr, "usage: %s [-n items] [-l samples] [-c capacity] "
+            "[-p producers] [-q consumers]\n", argv[0]);
+        return -1;
+    }
+
+  if (!items || !samples || !capacity ||
+      producers < 1 || producers > MAX_THREADS ||
+      consumers < 1 || consumers > MAX_THREADS)
+  {
+    fprintf(stderr, "items, samples and capacity must be at least 1 and "
+        "producers and consumers 1-%d\n", MAX_THREADS);
+    return -1;
+  }
+
+  /* adlGetClockNS is relative to adlInitialize, run on the same clock base as
+   * an application does. No platform is needed, silence the messages about
+   * them to keep stdout for the results */
+  ADLSetLogHandlersMask(adlLogHandlers, 0);
+  adlInitialize();
+  ADLSetLogHandlersMask(adlLogHandlers, ~0U);
+
+  printf("{\"bench\":\"queue\",\"items\":%u,\"capacity\":%u,"
+      "\"cpus\":%u,\"throughput\":{", items, capacity, adlGetCPUCount());
+  for(unsigned int i = 0; i < KIND_COUNT; ++i)
+    ok &= runThroughput(&kinds[i], items, capacity, producers, consumers,
+        i == KIND_COUNT - 1);
+
+  printf("},\"latency\":{");
+  for(unsigned int i = 0; i < KIND_COUNT; ++i)
+    ok &= runLatency(&kinds[i], samples, i == KIND_COUNT - 1);
+
+  printf("},\"timed_wait\":{");
+  ok &= runTimedWait();
+  printf("}}\n");
+
+  return ok ? 0 : -1;
+}
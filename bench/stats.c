@@ -0,0 +1,52 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "stats.h"
+
+#include <stdlib.h>
+
+static int compareU64(const void * a, const void * b)
+{
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+void statsSort(uint64_t * samples, unsigned int count)
+{
+  qsort(samples, count, sizeof(*samples), compareU64);
+}
+
+uint64_t statsPercentile(const uint64_t * sorted, unsigned int count,
+    double p)
+{
+  if (!count)
+    return 0;
+
+  unsigned int i = (unsigned int)(p * count);
+  if (i >= count)
+    i = count - 1;
+  return sorted[i];
+}
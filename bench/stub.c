@@ -0,0 +1,330 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+/*
+ * A platform without a display server for adl-bench-threads -n
+ *
+ * It has the same locking contract as the XCB platform: every window and
+ * image call modifies the per-window data without locking of its own, and
+ * processEvent looks the window up with windowFindLocked, modifies it and
+ * returns it locked. Any call ADL makes without holding the right window lock
+ * shows up as a data race under ThreadSanitizer. It does not exercise the
+ * X11 code itself, XInitThreads or the server round trips.
+ */
+
+#include "src/window.h"
+#include "src/image.h"
+#include "interface/adl.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+/* windows processEvent picks from to generate events */
+#define STUB_WINDOWS 32
+
+typedef struct
+{
+  uint64_t     serial;
+  bool         visible;
+  bool         grab;
+  bool         relative;
+  int          pointerX, pointerY;
+  unsigned int images;
+  char         title[64];
+}
+WindowData;
+
+typedef struct
+{
+  ADLImageDef def;
+  uint64_t    serial;
+  uint32_t    checksum;
+}
+ImageData;
+
+static atomic_ulong stubNextId = 1;
+static atomic_ulong stubWindows[STUB_WINDOWS];
+static atomic_uint  stubEventSeq;
+
+static ADL_STATUS stubOk(void)
+{
+  return ADL_OK;
+}
+
+static ADL_STATUS stubProcessEvent(int timeout, ADLEvent * event)
+{
+  const unsigned int seq = atomic_fetch_add(&stubEventSeq, 1);
+  const ADLWindowId  id  =
+    atomic_load(&stubWindows[seq % STUB_WINDOWS]);
+
+  if (!id || !(event->window = windowFindLocked(id)))
+  {
+    if (timeout)
+      usleep(100);
+    return ADL_OK;
+  }
+
+  WindowData * wdata = ADL_GET_WINDOW_DATA(event->window);
+  ++wdata->serial;
+  wdata->pointerX = seq % 256;
+
+  event->type      = ADL_EVENT_MOUSE_MOVE;
+  event->u.mouse.x = wdata->pointerX;
+  event->u.mouse.y = wdata->pointerY;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowCreate(const ADLWindowDef def, ADLWindow * result)
+{
+  const ADLWindowId id = atomic_fetch_add(&stubNextId, 1);
+  ADL_SET_WINDOW_ID(result, id);
+
+  WindowData * wdata = ADL_GET_WINDOW_DATA(result);
+  memset(wdata, 0, sizeof(*wdata));
+  strncpy(wdata->title, def.title ? def.title : "", sizeof(wdata->title) - 1);
+
+  atomic_store(&stubWindows[id % STUB_WINDOWS], id);
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowDestroy(ADLWindow * window)
+{
+  const ADLWindowId id = ADL_GET_WINDOW_ID(window);
+  ADLWindowId expected = id;
+  atomic_compare_exchange_strong(&stubWindows[id % STUB_WINDOWS], &expected,
+      0);
+
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowOp(ADLWindow * window)
+{
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowShow(ADLWindow * window)
+{
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  wdata->visible = true;
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowHide(ADLWindow * window)
+{
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  wdata->visible = false;
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowSetTitle(ADLWindow * window, const char * title)
+{
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  strncpy(wdata->title, title, sizeof(wdata->title) - 1);
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowSetClassName(ADLWindow * window,
+    const char * className)
+{
+  return stubWindowOp(window);
+}
+
+static ADL_STATUS stubWindowSetGrab(ADLWindow * window, bool enable)
+{
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  wdata->grab = enable;
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowSetRelative(ADLWindow * window, bool enable)
+{
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  wdata->relative = enable;
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubWindowEvent(ADLWindow * window, ADLEvent * event)
+{
+  return stubWindowOp(window);
+}
+
+static ADL_STATUS stubImageGetSupported(const ADLImageBackend ** result)
+{
+  static const ADLImageBackend supported[] =
+  {
+    ADL_IMAGE_BACKEND_BUFFER,
+    0
+  };
+  *result = supported;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubImageCreate(ADLWindow * window, const ADLImageDef def,
+    ADLImage * result)
+{
+  if (def.backend != ADL_IMAGE_BACKEND_BUFFER)
+    return ADL_ERR_UNSUPPORTED_BACKEND;
+
+  ADL_SET_IMAGE_ID(result, atomic_fetch_add(&stubNextId, 1));
+
+  ImageData * idata = ADL_GET_IMAGE_DATA(result);
+  idata->def = def;
+
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  ++wdata->images;
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubImageDestroy(ADLImage * image)
+{
+  WindowData * wdata = ADL_GET_WINDOW_DATA(image->window);
+  --wdata->images;
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+/* read the pixels like a put image would */
+static void stubUpload(ADLImage * image, const void * buffer)
+{
+  ImageData         * idata = ADL_GET_IMAGE_DATA(image);
+  const ADLImageDef * def   = &idata->def;
+  const uint32_t    * data  = buffer ? buffer : def->u.buffer;
+
+  uint32_t sum = 0;
+  for(unsigned int y = 0; y < def->h; ++y)
+    sum += data[y * (def->pitch / 4) + y % def->w];
+
+  idata->checksum = sum;
+  ++idata->serial;
+  ++((WindowData *)ADL_GET_WINDOW_DATA(image->window))->serial;
+}
+
+static ADL_STATUS stubImageUpdate(ADLImage * image)
+{
+  stubUpload(image, NULL);
+  return ADL_OK;
+}
+
+static ADL_STATUS stubImageUpdateRects(ADLImage * image, const void * buffer,
+    const ADLRect * rects, unsigned int count)
+{
+  stubUpload(image, buffer);
+  return ADL_OK;
+}
+
+static ADL_STATUS stubImagePresentAt(ADLImage * image, int x, int y,
+    const ADLRect * src)
+{
+  ImageData * idata = ADL_GET_IMAGE_DATA(image);
+  ++idata->serial;
+  return stubWindowOp(image->window);
+}
+
+static ADL_STATUS stubPointerWarp(ADLWindow * window, int x, int y)
+{
+  WindowData * wdata = ADL_GET_WINDOW_DATA(window);
+  wdata->pointerX = x;
+  wdata->pointerY = y;
+  ++wdata->serial;
+  return ADL_OK;
+}
+
+static ADL_STATUS stubPointerVisible(ADLWindow * window, bool visible)
+{
+  return stubWindowOp(window);
+}
+
+static ADL_STATUS stubPointerSetCursor(ADLWindow * window, ADLImage * source,
+    ADLImage * mask, int x, int y)
+{
+  if (source)
+    ++((ImageData *)ADL_GET_IMAGE_DATA(source))->serial;
+  return stubWindowOp(window);
+}
+
+#if defined(ADL_HAS_EGL)
+static ADL_STATUS stubEGLGetDisplay(EGLDisplay ** display)
+{
+  return ADL_ERR_UNSUPPORTED;
+}
+
+static ADL_STATUS stubEGLCreateWindowSurface(EGLDisplay * display,
+  EGLint * config, ADLWindow * window, const EGLint * attribs,
+  EGLSurface * surface)
+{
+  return ADL_ERR_UNSUPPORTED;
+}
+#endif
+
+static struct ADLPlatform stub =
+{
+  .name               = "stub",
+  .test               = stubOk,
+  .init               = stubOk,
+  .deinit             = stubOk,
+  .processEvent       = stubProcessEvent,
+  .flush              = stubOk,
+
+  .windowDataSize     = sizeof(WindowData),
+  .windowCreate       = stubWindowCreate,
+  .windowDestroy      = stubWindowDestroy,
+  .windowShow         = stubWindowShow,
+  .windowHide         = stubWindowHide,
+  .windowSetTitle     = stubWindowSetTitle,
+  .windowSetClassName = stubWindowSetClassName,
+  .windowSetGrab      = stubWindowSetGrab,
+  .windowSetRelative  = stubWindowSetRelative,
+  .windowSetFocus     = stubWindowOp,
+  .windowEvent        = stubWindowEvent,
+
+  .imageDataSize      = sizeof(ImageData),
+  .imageGetSupported  = stubImageGetSupported,
+  .imageCreate        = stubImageCreate,
+  .imageDestroy       = stubImageDestroy,
+  .imageUpdate        = stubImageUpdate,
+  .imageUpdateRects   = stubImageUpdateRects,
+  .imagePresentAt     = stubImagePresentAt,
+
+  .pointerWarp        = stubPointerWarp,
+  .pointerVisible     = stubPointerVisible,
+  .pointerSetCursor   = stubPointerSetCursor,
+
+#if defined(ADL_HAS_EGL)
+  .eglGetDisplay          = stubEGLGetDisplay,
+  .eglCreateWindowSurface = stubEGLCreateWindowSurface
+#endif
+};
+
+adl_platform(stub);
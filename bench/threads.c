@@ -0,0 +1,312 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+/*
+ * Thread-safe mode stress benchmark
+ *
+ * Starts a private Xvfb and enables adlSetThreadSafe, then runs the event
+ * loop on the main thread while render threads each update and present an
+ * image in their own window and warp the pointer, and a churn thread
+ * repeatedly creates and destroys windows with images. The latency of every
+ * frame is recorded, any failed call fails the run.
+ *
+ * Build with -DBENCH_TSAN=ON to run under ThreadSanitizer, the
+ * bench-threads-tsan target runs it against the stub platform (stub.c) which
+ * checks ADL's own locking without needing an X server:
+ *
+ *   cmake -S bench -B build -DBENCH_TSAN=ON
+ *   cmake --build build --target bench-threads-tsan
+ *
+ * The results are printed to stdout as a single line of JSON.
+ *
+ * usage: adl-bench-threads [-s seconds] [-r renderers] [-d | -n]
+ *
+ *   -d  use the X server in $DISPLAY instead of starting Xvfb
+ *   -n  use the stub platform instead of X
+ */
+
+#include <adl/adl.h>
+#include "xvfb.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MAX_RENDERERS 16
+#define IMAGE_SIZE    128
+#define MAX_FRAMES    (1 << 20)
+
+typedef struct
+{
+  pthread_t   thread;
+  ADLWindow * window;
+  uint32_t  * pixels;
+  uint64_t  * samples;
+  unsigned int frames;
+  bool        ok;
+}
+Renderer;
+
+static atomic_bool  running = true;
+static atomic_uint  failures;
+static atomic_ulong churned;
+
+#define CHECK(x) \
+  ({ \
+    ADL_STATUS __status = (x); \
+    if (__status != ADL_OK) \
+    { \
+      fprintf(stderr, "%s failed: %s\n", #x, adlStatusString(__status)); \
+      ++failures; \
+    } \
+    __status == ADL_OK; \
+  })
+
+static ADLImageDef imageDef(uint32_t * pixels)
+{
+  return (ADLImageDef)
+  {
+    .backend  = ADL_IMAGE_BACKEND_BUFFER,
+    .format   = ADL_IMAGE_FORMAT_BGRA,
+    .bpp      = 32,
+    .depth    = 32,
+    .pitch    = IMAGE_SIZE * 4,
+    .w        = IMAGE_SIZE,
+    .h        = IMAGE_SIZE,
+    .u.buffer = pixels
+  };
+}
+
+static void * renderThread(void * opaque)
+{
+  Renderer * r = opaque;
+
+  ADLImage * image;
+  if (!CHECK(adlImageCreate(r->window, imageDef(r->pixels), &image)))
+    return NULL;
+
+  for(uint32_t frame = 0; running && r->frames < MAX_FRAMES; ++frame)
+  {
+    const uint64_t start = adlGetClockNS();
+
+    for(unsigned int i = 0; i < IMAGE_SIZE * IMAGE_SIZE; ++i)
+      r->pixels[i] = frame * 0x010101 + i;
+
+    if (!CHECK(adlImageUpdate(image)) ||
+        !CHECK(adlImagePresentAt(image, 0, 0, NULL)))
+      break;
+
+    if ((frame & 15) == 0 &&
+        !CHECK(adlPointerWarp(r->window, frame % IMAGE_SIZE, IMAGE_SIZE / 2)))
+      break;
+
+    if (!CHECK(adlFlush()))
+      break;
+
+    r->samples[r->frames++] = adlGetClockNS() - start;
+  }
+
+  r->ok = CHECK(adlImageDestroy(&image));
+  return NULL;
+}
+
+static void * churnThread(void * opaque)
+{
+  uint32_t * pixels = opaque;
+
+  const ADLWindowDef def =
+  {
+    .title      = "ADL Threads Bench",
+    .className  = "adl-bench",
+    .type       = ADL_WINDOW_TYPE_NORMAL,
+    .borderless = true,
+    .w          = IMAGE_SIZE,
+    .h          = IMAGE_SIZE
+  };
+
+  while(running)
+  {
+    ADLWindow * window;
+    ADLImage  * image;
+    if (!CHECK(adlWindowCreate(def, &window)))
+      break;
+
+    if (CHECK(adlImageCreate(window, imageDef(pixels), &image)))
+    {
+      CHECK(adlPointerSetCursor(window, image, NULL, 0, 0));
+      CHECK(adlWindowShow(window));
+      CHECK(adlWindowSetTitle(window, "ADL Threads Bench (churn)"));
+      CHECK(adlImageDestroy(&image));
+    }
+
+    CHECK(adlWindowDestroy(&window));
+    ++churned;
+  }
+
+  return NULL;
+}
+
+int main(int argc, char * argv[])
+{
+  unsigned int seconds   = 10;
+  unsigned int renderers = 4;
+  bool         useXvfb   = true;
+  const char * platform  = "XCB";
+  int          retval    = -1;
+
+  int opt;
+  while((opt = getopt(argc, argv, "s:r:dn")) != -1)
+    switch(opt)
+    {
+      case 's': seconds   = strtoul(optarg, NULL, 10); break;
+      case 'r': renderers = strtoul(optarg, NULL, 10); break;
+      case 'd': useXvfb   = false; break;
+      case 'n': useXvfb   = false; platform = "stub"; break;
+      default:
+        fprintf(stderr,
+            "usage: %s [-s seconds] [-r renderers] [-d | -n]\n", argv[0]);
+        return -1;
+    }
+
+  if (!seconds || renderers < 1 || renderers > MAX_RENDERERS)
+  {
+    fprintf(stderr, "at least 1 second and 1-%d renderers are required\n",
+        MAX_RENDERERS);
+    return -1;
+  }
+
+  Renderer   r[MAX_RENDERERS] = { 0 };
+  uint32_t * churnPixels      = calloc(IMAGE_SIZE * IMAGE_SIZE, 4);
+  for(unsigned int i = 0; i < renderers; ++i)
+    if (!(r[i].pixels  = calloc(IMAGE_SIZE * IMAGE_SIZE, 4)) ||
+        !(r[i].samples = malloc(sizeof(uint64_t) * MAX_FRAMES)))
+      goto err_mem;
+
+  if (!churnPixels)
+    goto err_mem;
+
+  if (useXvfb && !xvfbStart())
+    goto err_xvfb;
+
+  /* keep stdout for the results */
+  ADLSetLogHandlersMask(adlLogHandlers, ~ADL_LOG_INFO);
+
+  if (adlInitialize() != ADL_OK || adlSetThreadSafe(true) != ADL_OK ||
+      adlUsePlatform(platform) != ADL_OK)
+    goto err_xvfb;
+
+  for(unsigned int i = 0; i < renderers; ++i)
+  {
+    const ADLWindowDef def =
+    {
+      .title      = "ADL Threads Bench",
+      .className  = "adl-bench",
+      .type       = ADL_WINDOW_TYPE_NORMAL,
+      .borderless = true,
+      .x          = (i % 4) * IMAGE_SIZE,
+      .y          = (i / 4) * IMAGE_SIZE,
+      .w          = IMAGE_SIZE,
+      .h          = IMAGE_SIZE
+    };
+
+    if (!CHECK(adlWindowCreate(def, &r[i].window)) ||
+        !CHECK(adlWindowShow(r[i].window)))
+      goto err_shutdown;
+  }
+  adlFlush();
+
+  pthread_t churn;
+  const uint64_t start = adlGetClockNS();
+  for(unsigned int i = 0; i < renderers; ++i)
+    pthread_create(&r[i].thread, NULL, renderThread, &r[i]);
+  pthread_create(&churn, NULL, churnThread, churnPixels);
+
+  /* the event loop stays on this thread */
+  uint64_t events = 0;
+  const uint64_t until = start + seconds * 1000000000ULL;
+  while(adlGetClockNS() < until)
+  {
+    ADLEvent event;
+    if (!CHECK(adlProcessEvent(1, &event)))
+      break;
+
+    if (event.type != ADL_EVENT_NONE)
+      ++events;
+  }
+
+  running = false;
+  for(unsigned int i = 0; i < renderers; ++i)
+    pthread_join(r[i].thread, NULL);
+  pthread_join(churn, NULL);
+  const double elapsed = (adlGetClockNS() - start) / 1e9;
+
+  unsigned int frames = 0;
+  uint64_t   * all    = malloc(sizeof(uint64_t) * MAX_FRAMES * renderers);
+  if (!all)
+    goto err_shutdown;
+
+  for(unsigned int i = 0; i < renderers; ++i)
+  {
+    memcpy(all + frames, r[i].samples, sizeof(uint64_t) * r[i].frames);
+    frames += r[i].frames;
+    if (!r[i].ok)
+      ++failures;
+  }
+  statsSort(all, frames);
+
+  printf("{\"bench\":\"threads\",\"seconds\":%.6f,\"renderers\":%u,"
+      "\"cpus\":%u,\"frames\":%u,\"fps\":%.1f,"
+      "\"frame_p50_ns\":%" PRIu64 ",\"frame_p99_ns\":%" PRIu64 ","
+      "\"frame_max_ns\":%" PRIu64 ",\"events\":%" PRIu64 ","
+      "\"churned_windows\":%lu,\"failures\":%u}\n",
+      elapsed, renderers, adlGetCPUCount(), frames, frames / elapsed,
+      statsPercentile(all, frames, 0.50),
+      statsPercentile(all, frames, 0.99),
+      frames ? all[frames - 1] : 0, events,
+      (unsigned long)churned, (unsigned int)failures);
+  free(all);
+
+  retval = failures ? -1 : 0;
+
+err_shutdown:
+  for(unsigned int i = 0; i < renderers; ++i)
+    adlWindowDestroy(&r[i].window);
+  adlShutdown();
+err_xvfb:
+  xvfbStop();
+err_mem:
+  for(unsigned int i = 0; i < renderers; ++i)
+  {
+    free(r[i].pixels);
+    free(r[i].samples);
+  }
+  free(churnPixels);
+  return retval;
+}
@@ -0,0 +1,102 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "xvfb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+static pid_t xvfbPid = 0;
+
+bool xvfbStart(void)
+{
+  int fds[2];
+  if (pipe(fds) < 0)
+  {
+    perror("pipe");
+    return false;
+  }
+
+  if ((xvfbPid = fork()) < 0)
+  {
+    perror("fork");
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (xvfbPid == 0)
+  {
+    /* Xvfb picks a free display and writes the number to displayfd */
+    char fd[16];
+    snprintf(fd, sizeof(fd), "%d", fds[1]);
+    close(fds[0]);
+    execlp("Xvfb", "Xvfb", "-displayfd", fd, "-screen", "0", "1024x768x24",
+        "-nolisten", "tcp", "-noreset", NULL);
+    _exit(127);
+  }
+
+  close(fds[1]);
+
+  char buf[16] = { 0 };
+  size_t len = 0;
+  struct pollfd pfd = { .fd = fds[0], .events = POLLIN };
+  while(len < sizeof(buf) - 1 && poll(&pfd, 1, 10000) > 0)
+  {
+    const ssize_t n = read(fds[0], buf + len, sizeof(buf) - 1 - len);
+    if (n <= 0)
+      break;
+    len += n;
+    if (buf[len - 1] == '\n')
+      break;
+  }
+  close(fds[0]);
+
+  if (!len || buf[len - 1] != '\n')
+  {
+    fprintf(stderr, "Xvfb failed to start\n");
+    xvfbStop();
+    return false;
+  }
+
+  char display[24];
+  snprintf(display, sizeof(display), ":%d", atoi(buf));
+  setenv("DISPLAY", display, 1);
+  return true;
+}
+
+void xvfbStop(void)
+{
+  if (xvfbPid <= 0)
+    return;
+
+  kill(xvfbPid, SIGTERM);
+  waitpid(xvfbPid, NULL, 0);
+  xvfbPid = 0;
+}
@@ -147,6 +147,14 @@ int main()
         printf("%s: hide event\n", src);
         break;
 
+      case ADL_EVENT_FOCUS_IN:
+        printf("%s: focus in event\n", src);
+        break;
+
+      case ADL_EVENT_FOCUS_OUT:
+        printf("%s: focus out event\n", src);
+        break;
+
       case ADL_EVENT_WINDOW_CHANGE:
         printf("%s: change event: x:%-4d y:%-4d w:%-4d h:%-4d\n",
             src,
@@ -76,6 +76,8 @@ GLuint loadShader(const char * src, GLenum type)
 
 void * renderThread(ADLThread * thread, void * opaque)
 {
+  ADLWindow * window = opaque;
+
   if (!eglMakeCurrent(display, surface, surface, context))
   {
     printf("eglMakeCurrent failed\n");
@@ -122,11 +124,24 @@ void * renderThread(ADLThread * thread, void * opaque)
      0.5f, -0.5f, 0.0f
   };
 
+  /* lock to the period of the swaps which block on vsync */
+  ADLFramePacer pacer;
+  adlFramePacerInit(&pacer, 1000000000ULL / TARGET_FPS);
+  adlFramePacerSetLock(&pacer, true);
+
+  uint32_t serial = 0;
   while(adlThreadIsRunning(thread))
   {
-    const int64_t start = adlGetClockNS();
+    adlFramePacerWait(&pacer, NULL);
 
-    glViewport(0, 0, winW, winH);
+    /* the size published by the event loop, no locking required */
+    ADLWindowState state;
+    adlWindowGetState(window, &state);
+    if (state.serial != serial)
+    {
+      glViewport(0, 0, state.w, state.h);
+      serial = state.serial;
+    }
 
     glClear(GL_COLOR_BUFFER_BIT);
     glUseProgram(program);
@@ -135,10 +150,16 @@ void * renderThread(ADLThread * thread, void * opaque)
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
     eglSwapBuffers(display, surface);
-
-    adlWaitUntilNS(start + (1000000000LL / TARGET_FPS));
+    adlFramePacerPresented(&pacer, adlGetClockNS());
   }
 
+  ADLFramePacerStats stats;
+  adlFramePacerGetStats(&pacer, &stats);
+  printf("frames: %lu, missed: %lu, skipped: %lu, period: %luns\n",
+      (unsigned long)stats.frames, (unsigned long)stats.missed,
+      (unsigned long)stats.skipped,
+      (unsigned long)adlFramePacerGetPeriod(&pacer));
+
   glDeleteShader(vertShader);
   glDeleteShader(fragShader);
   glDeleteProgram(program);
@@ -285,8 +306,22 @@ int main(int argc, char * argv[])
 
   free(configs);
 
-  ADLThread thread;
-  adlThreadCreate(renderThread, NULL, &thread);
+  /* keep the render thread from being preempted by background work, this
+   * needs CAP_SYS_NICE or an RLIMIT_RTPRIO, otherwise it falls back to nice */
+  const ADLThreadAttr renderAttr =
+  {
+    .name     = "render",
+    .sched    = ADL_THREAD_SCHED_FIFO,
+    .priority = 10,
+    .nice     = -10
+  };
+
+  ADLThread    thread;
+  unsigned int applied;
+  adlThreadCreateEx(renderThread, window, &renderAttr, &thread, &applied);
+  printf("render thread: %s\n",
+      (applied & ADL_THREAD_APPLIED_SCHED) ? "real-time" :
+      (applied & ADL_THREAD_APPLIED_NICE ) ? "nice"      : "default priority");
 
   /* show the window */
   adlWindowShow(window);
@@ -303,11 +338,6 @@ int main(int argc, char * argv[])
         printf("close event\n");
         goto exit;
 
-      case ADL_EVENT_WINDOW_CHANGE:
-        winW = event.u.win.w;
-        winH = event.u.win.h;
-        break;
-
       default:
         break;
     }
@@ -23,15 +23,18 @@
 */
 
 #include <adl/adl.h>
-#include <unistd.h>
 #include <stdio.h>
 
-static int count = 0;
+#define TICKS 10
+
+static int      count = 0;
+static ADLLatch done;
 
 bool timerFunc(void * udata)
 {
   printf("Tick %d\n", ++count);
-  return true;
+  adlLatchCountDown(&done, 1);
+  return count < TICKS;
 }
 
 int main()
@@ -65,11 +68,12 @@ int main()
     }
   }
 
-  ADLTimer timer;
-  adlTimerCreate(1000, timerFunc, NULL, &timer);
+  /* sleep until the timer thread has ticked enough times */
+  adlLatchInit(&done, TICKS);
 
-  while(count < 10)
-    usleep(100);
+  ADLTimer timer;
+  adlTimerCreate(100000000, timerFunc, NULL, &timer);
+  adlLatchWait(&done, -1);
 
   printf("shutdown\n");
   adlTimerDestroy(&timer);
@@ -33,11 +33,70 @@
 #include "util.h"
 #include "thread.h"
 #include "timer.h"
+#include "trace.h"
+#include "pacer.h"
+#include "job.h"
+#include "queue.h"
+#include "sync.h"
+
+#include <stdint.h>
 
 #if defined(ADL_HAS_EGL)
 #include <EGL/egl.h>
 #endif
 
+/* allocator statistics for the window and image storage */
+typedef struct
+{
+  uint64_t allocs;  // blocks allocated
+  uint64_t avoided; // allocations served without calling malloc
+  uint64_t chunks;  // chunks allocated from the heap
+  uint64_t inUse;   // blocks currently allocated
+}
+ADLAllocStats;
+
+#define ADL_STATS_BUCKETS 20
+
+/* blocking platform round trips made from one call site */
+typedef struct
+{
+  const char * call;    // the blocking platform function
+  const char * file;
+  unsigned int line;
+  const char * api;     // the ADL function it was made from, NULL for threads
+  uint64_t     count;
+  uint64_t     inEvent; // made from inside adlProcessEvent
+  uint64_t     totalNS;
+  uint64_t     maxNS;
+
+  /* bucket 0 counts waits under 1us, bucket n waits of [2^(n-1), 2^n)us and
+   * the last bucket also everything longer */
+  uint64_t     histogram[ADL_STATS_BUCKETS];
+}
+ADLRoundTripStats;
+
+typedef struct
+{
+  uint64_t     count;
+  uint64_t     inEvent;
+  uint64_t     totalNS;
+  uint64_t     histogram[ADL_STATS_BUCKETS];
+  unsigned int siteCount;
+}
+ADLPlatformStats;
+
+/* timings of one platform entry point */
+typedef struct
+{
+  const char * name;
+  uint64_t     count;
+  uint64_t     minNS;
+  uint64_t     avgNS;
+  uint64_t     maxNS;
+  uint64_t     p99NS; // accurate to within 12.5%
+}
+ADLCallStats;
+
 ADL_STATUS adlInitialize();
 ADL_STATUS adlShutdown();
 ADL_STATUS adlQuit();
@@ -45,7 +104,51 @@ ADL_STATUS adlQuit();
 ADL_STATUS adlGetPlatformList(int * count, const char * names[]);
 ADL_STATUS adlUsePlatform(const char * name);
 ADL_STATUS adlProcessEvent(int timeout, ADLEvent * event);
+
+/* Pending events are translated into a fixed size queue that
+ * adlProcessEvent returns from before waiting on the platform.
+ *
+ * adlPeekEvents copies up to `max` queued events matching `types` into `out`
+ * without removing them, if `out` is NULL only the matching events are
+ * counted. adlFlushEvents discards all queued events matching `types`. */
+ADL_STATUS adlPeekEvents(ADLEventMask types, ADLEvent * out, unsigned int max,
+    unsigned int * count);
+ADL_STATUS adlFlushEvents(ADLEventMask types);
 ADL_STATUS adlFlush(void);
+ADL_STATUS adlGetAllocStats(ADLAllocStats * windows, ADLAllocStats * images);
+
+/* get the blocking round trip statistics, only recorded if ADL was built with
+ * ADL_AUDIT, otherwise ADL_ERR_UNSUPPORTED is returned. Up to `maxSites` call
+ * sites are copied into `sites` which may be NULL */
+ADL_STATUS adlGetPlatformStats(ADLPlatformStats * stats,
+    ADLRoundTripStats * sites, unsigned int maxSites);
+
+/* Time every call into the platform backend, must be called before
+ * adlUsePlatform. adlGetPlatformCallStats sets `count` to the number of entry
+ * points and copies up to `max` of them into `stats` which may be NULL, if
+ * profiling is not enabled ADL_ERR_UNSUPPORTED is returned. Note that the
+ * processEvent timings include the time spent waiting for events. */
+ADL_STATUS adlSetPlatformProfiling(bool enable);
+ADL_STATUS adlGetPlatformCallStats(ADLCallStats * stats, unsigned int max,
+    unsigned int * count);
+ADL_STATUS adlResetPlatformCallStats(void);
+
+/* Allow ADL to be called from more than one thread, must be called before
+ * adlUsePlatform.
+ *
+ * The window registry is guarded by a read-mostly lock and each window by its
+ * own lock which covers its images and pointer state, so threads working on
+ * different windows do not contend. The platform connection is made safe for
+ * concurrent requests (Xlib is initialized with XInitThreads).
+ *
+ * The following rules still apply:
+ *  - adlProcessEvent, adlPeekEvents and adlFlushEvents must be called from
+ *    one thread, the event thread, which owns the public ADLWindow fields.
+ *  - a window or image must not be used by any thread once it has been
+ *    destroyed, including through events returned by an adlProcessEvent call
+ *    that was in progress, destroy windows from the event thread to avoid
+ *    this. */
+ADL_STATUS adlSetThreadSafe(bool enable);
 
 ADL_STATUS adlPointerWarp(ADLWindow * window, int x, int y);
 ADL_STATUS adlPointerVisible(ADLWindow * window, bool visible);
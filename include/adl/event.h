@@ -49,10 +49,21 @@ typedef enum
   ADL_EVENT_MOUSE_DOWN,
   ADL_EVENT_MOUSE_UP,
   ADL_EVENT_MOUSE_ENTER,
-  ADL_EVENT_MOUSE_LEAVE
+  ADL_EVENT_MOUSE_LEAVE,
+
+  ADL_EVENT_TIMER,
+
+  ADL_EVENT_FOCUS_IN,
+  ADL_EVENT_FOCUS_OUT
 }
 ADLEventType;
 
+/* event type masks for adlPeekEvents and adlFlushEvents */
+typedef uint32_t ADLEventMask;
+
+#define ADL_EVENT_MASK(type) ((ADLEventMask)1 << (type))
+#define ADL_EVENT_MASK_ALL   (~(ADLEventMask)0)
+
 typedef struct
 {
   int x, y, w, h;
@@ -110,6 +121,15 @@ typedef struct
 }
 ADLEventMouse;
 
+typedef struct
+{
+  struct _ADLTimer * timer;
+  void *             udata;
+  // number of intervals that elapsed, more than 1 if the loop fell behind
+  uint64_t           expirations;
+}
+ADLEventTimer;
+
 typedef struct
 {
   ADLEventType type;
@@ -120,6 +140,7 @@ typedef struct
     ADLEventPaint    paint;
     ADLEventKeyboard key;
     ADLEventMouse    mouse;
+    ADLEventTimer    timer;
   } u;
 }
 ADLEvent;
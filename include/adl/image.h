@@ -28,6 +28,7 @@
 #include "window.h"
 
 #include <sys/types.h>
+#include <stdint.h>
 
 typedef enum
 {
@@ -39,10 +40,48 @@ ADLImageBackend;
 typedef enum
 {
   ADL_IMAGE_FORMAT_RGBA,
-  ADL_IMAGE_FORMAT_BGRA
+  ADL_IMAGE_FORMAT_BGRA,
+
+  /* packed formats defined by their native endian pixel value, the bpp and
+   * depth fields are ignored for these */
+  ADL_IMAGE_FORMAT_RGB565,      // 16-bit, R:G:B 5:6:5
+  ADL_IMAGE_FORMAT_XRGB2101010, // 32-bit, X:R:G:B 2:10:10:10
+
+  /* planar YUV 4:2:0 formats, these are converted to RGB on upload and as such
+   * are only supported by the buffer backend */
+  ADL_IMAGE_FORMAT_NV12, // Y plane followed by an interleaved UV plane
+  ADL_IMAGE_FORMAT_I420  // Y plane followed by separate U and V planes
 }
 ADLImageFormat;
 
+typedef enum
+{
+  ADL_IMAGE_COLORSPACE_BT601, // SD video, limited range
+  ADL_IMAGE_COLORSPACE_BT709  // HD video, limited range
+}
+ADLImageColorSpace;
+
+typedef struct
+{
+  unsigned int offset; // byte offset of the plane from the start of the buffer
+  unsigned int pitch;  // number of bytes in a single row including padding
+}
+ADLImagePlane;
+
+typedef enum
+{
+  /* buffer images only, keep a copy of the last frame and only upload and
+   * present the tiles that have changed on update */
+  ADL_IMAGE_FLAG_DIFF = 0x1
+}
+ADLImageFlag;
+
+typedef struct
+{
+  int x, y, w, h;
+}
+ADLRect;
+
 typedef struct
 {
   int    fd    ; // the dma file descriptor
@@ -60,6 +99,14 @@ typedef struct
   unsigned int    pitch;   // number of bytes in a single row including padding
   unsigned int    w;       // width
   unsigned int    h;       // height
+  ADLImageFlag    flags;   // this is a bitfield
+
+  /* YUV formats only, the planes are in Y, U, V order, for NV12 the second
+   * plane contains both U and V and the third plane is unused. The bpp, depth
+   * and pitch fields are ignored as the image is converted to suit the window */
+  ADLImageColorSpace colorSpace;
+  ADLImagePlane      planes[3];
+
   union
   {
     ADLImageDMABuf dmabuf;
@@ -69,6 +116,19 @@ typedef struct
 }
 ADLImageDef;
 
+/* statistics for images created with ADL_IMAGE_FLAG_DIFF, the bytes saved is
+ * the difference between bytesTotal and bytesUploaded */
+typedef struct
+{
+  uint64_t updates;       // number of calls to adlImageUpdate
+  uint64_t skipped;       // updates that had no changes and were not presented
+  uint64_t tiles;         // number of tiles compared
+  uint64_t dirtyTiles;    // number of tiles that had changed
+  uint64_t bytesTotal;    // bytes that would have been uploaded without diffing
+  uint64_t bytesUploaded; // bytes that were uploaded
+}
+ADLImageStats;
+
 /* everything in the structure is read-only to the application! */
 typedef struct
 {
@@ -91,4 +151,31 @@ ADL_STATUS adlImageDestroy(ADLImage ** image);
 /* update the image from it's backend storage */
 ADL_STATUS adlImageUpdate(ADLImage * image);
 
+/* called once `buffer` may be reused, `dropped` is set if the frame will not
+ * be presented. Frames that were copied are reported from the upload thread,
+ * dropped frames synchronously on the caller's thread from inside the
+ * adlImageSubmit, adlImageDestroy, adlWindowDestroy or adlShutdown call that
+ * dropped them */
+typedef void (*ADLImageSubmitFn)(ADLImage * image, const void * buffer,
+    bool dropped, void * udata);
+
+/* queue `buffer` to be copied, uploaded and presented by the upload thread
+ * which is started on first use. The call returns immediately, frames are
+ * presented in order and a frame that is still queued when the next one is
+ * submitted is dropped. `fn` may be NULL. Buffer images only, the image must
+ * not be updated with adlImageUpdate while frames are in flight.
+ *
+ * The upload thread calls into the platform, so this requires thread-safe
+ * mode (adlSetThreadSafe) and returns ADL_ERR_UNSUPPORTED otherwise */
+ADL_STATUS adlImageSubmit(ADLImage * image, const void * buffer,
+    ADLImageSubmitFn fn, void * udata);
+
+/* update and present the `src` rectangle of the image at x,y in the window, if
+ * `src` is NULL the entire image is presented */
+ADL_STATUS adlImagePresentAt(ADLImage * image, int x, int y,
+    const ADLRect * src);
+
+/* get the statistics of an image created with ADL_IMAGE_FLAG_DIFF */
+ADL_STATUS adlImageGetStats(ADLImage * image, ADLImageStats * stats);
+
 #endif
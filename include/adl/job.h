@@ -0,0 +1,115 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_ADL_JOB
+#define _H_ADL_JOB
+
+#include "status.h"
+
+#include <stdatomic.h>
+
+typedef struct ADLJobSystem ADLJobSystem;
+
+/**
+ * Counts the outstanding jobs of a batch
+ *
+ * Zero initialize it, every job submitted with the counter increments it and
+ * decrements it once the job has run. It must remain valid until
+ * adlJobWait returns.
+ */
+typedef struct
+{
+  atomic_uint pending;
+}
+ADLJobCounter;
+
+typedef void (*ADLJobFn)(void * udata);
+
+/* process the indices [start, end) */
+typedef void (*ADLJobRangeFn)(unsigned int start, unsigned int end,
+    void * udata);
+
+/**
+ * Create a job system
+ *
+ * @param workers The number of worker threads, zero for the number of online
+ *                CPUs
+ * @param result  The new job system
+ *
+ * Each worker owns a deque it pushes and pops its own jobs from at one end,
+ * idle workers steal from the other end of the other workers' deques. Jobs
+ * submitted from threads that are not workers go on a shared queue.
+ */
+ADL_STATUS adlJobSystemCreate(unsigned int workers, ADLJobSystem ** result);
+
+/**
+ * Stop the workers and free the job system, every submitted job must have been
+ * waited on first
+ */
+void adlJobSystemDestroy(ADLJobSystem ** js);
+
+unsigned int adlJobSystemGetWorkers(const ADLJobSystem * js);
+
+/**
+ * Submit a job
+ *
+ * @param js      The job system
+ * @param fn      The job function
+ * @param udata   Application defined data, may be NULL
+ * @param counter The counter to track the job with, may be NULL
+ *
+ * If the job can not be queued it is run before returning.
+ */
+ADL_STATUS adlJobSubmit(ADLJobSystem * js, ADLJobFn fn, void * udata,
+    ADLJobCounter * counter);
+
+/**
+ * Run `fn` over the indices [0, count) in parallel
+ *
+ * @param js      The job system
+ * @param count   The number of indices
+ * @param grain   The smallest range to split off as a job, zero to pick one
+ *                from the number of workers
+ * @param fn      The range function
+ * @param udata   Application defined data, may be NULL
+ * @param counter The counter to track the ranges with
+ *
+ * The range is split in half recursively by the jobs themselves so that idle
+ * workers steal large ranges first. Call adlJobWait on the counter to wait for
+ * completion.
+ */
+ADL_STATUS adlJobParallelFor(ADLJobSystem * js, unsigned int count,
+    unsigned int grain, ADLJobRangeFn fn, void * udata,
+    ADLJobCounter * counter);
+
+/**
+ * Wait for every job tracked by `counter` to complete
+ *
+ * The calling thread runs queued jobs while it waits and only sleeps once
+ * there is nothing left for it to run.
+ */
+void adlJobWait(ADLJobSystem * js, ADLJobCounter * counter);
+
+#endif
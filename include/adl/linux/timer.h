@@ -29,13 +29,34 @@
 #error "do not include this header directly"
 #endif
 
-#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 typedef struct _ADLTimer
 {
-  void *  timerFn;
-  void *  udata;
-  timer_t timerID;
+  void *              timerFn;
+  void *              udata;
+  bool                event;    // delivered through adlProcessEvent
+  bool                active;
+  uint64_t            interval; // nanoseconds
+  uint64_t            slack;    // nanoseconds the expiry may be delayed by
+  uint64_t            deadline; // next expiry in CLOCK_MONOTONIC nanoseconds
+  uint64_t            overruns; // expirations that were not delivered
+  uint64_t            pending;  // expirations waiting to be delivered
+
+  /* timer wheel links */
+  uint64_t            expires;
+  unsigned int        slot;
+  struct _ADLTimer *  next;
+  struct _ADLTimer ** pprev;
+
+  /* pending event list links */
+  struct _ADLTimer *  pendNext;
+  struct _ADLTimer *  pendPrev;
+
+  /* expired callback timers waiting to be called outside the lock */
+  struct _ADLTimer *  fireNext;
+  bool                firing;
 }
 ADLTimer;
 
@@ -27,6 +27,8 @@
 
 #include "adl/status.h"
 
+#include <stdint.h>
+
 typedef enum
 {
   ADL_LOG_INFO  = 0x01,
@@ -39,6 +41,15 @@ typedef enum
 }
 ADL_LOG_LEVEL;
 
+/**
+ * Messages below this level are compiled out, their arguments are never
+ * evaluated. May be set to any ADL_LOG_LEVEL value, eg:
+ *   -DADL_LOG_MIN_LEVEL=ADL_LOG_WARN
+ */
+#ifndef ADL_LOG_MIN_LEVEL
+#define ADL_LOG_MIN_LEVEL ADL_LOG_INFO
+#endif
+
 /**
  * Called by ADL to log status and error messages
  */
@@ -63,7 +74,43 @@ struct ADLLogHandlers
 
 void ADLSetLogHandlers(const struct ADLLogHandlers log);
 
+/**
+ * Set the log handlers and the mask of ADL_LOG_LEVEL values to log
+ *
+ * The mask is checked before the message arguments are evaluated, messages
+ * for levels not in the mask cost a single load and branch. ADLSetLogHandlers
+ * keeps the current mask which defaults to all levels.
+ */
+void ADLSetLogHandlersMask(const struct ADLLogHandlers log,
+    unsigned int levelMask);
+
+/**
+ * Start the asynchronous logging backend
+ *
+ * Replaces the current handlers with ones that format each message into a per
+ * thread buffer and queue it on a lock-free ring, a background thread writes
+ * the ring out to stdout/stderr. If the ring is full the message is dropped
+ * instead of blocking the caller.
+ *
+ * Bug and fatal messages are not queued, the ring is drained and they are
+ * written synchronously through the previous handlers so they are not lost
+ * if the process goes down straight after.
+ */
+ADL_STATUS adlLogAsyncStart(void);
+
+/**
+ * Write out any queued messages, stop the writer thread and restore the
+ * handlers that were installed when adlLogAsyncStart was called
+ */
+void adlLogAsyncStop(void);
+
+/**
+ * Returns the number of messages dropped because the ring was full
+ */
+uint64_t adlLogAsyncDropped(void);
+
 extern struct ADLLogHandlers adlLogHandlers;
+extern unsigned int          adlLogLevelMask;
 
 #if defined(_WIN32) && !defined(__GNUC__)
   #define DIRECTORY_SEPARATOR '\\'
@@ -95,14 +142,15 @@ extern struct ADLLogHandlers adlLogHandlers;
 
 #define ADL_PRINT(type, level, status, fmt, ...) \
   do { \
-    adlLogHandlers.type(\
-      level, \
-      status, \
-      STRIPPATH(__FILE__), \
-      __LINE__, \
-      __FUNCTION__, \
-      fmt "\n", \
-      ##__VA_ARGS__); \
+    if ((level) >= ADL_LOG_MIN_LEVEL && (adlLogLevelMask & (level))) \
+      adlLogHandlers.type(\
+        level, \
+        status, \
+        STRIPPATH(__FILE__), \
+        __LINE__, \
+        __FUNCTION__, \
+        fmt "\n", \
+        ##__VA_ARGS__); \
   } while (0)
 
 #define ADL_INFO(status, fmt, ...)  \
@@ -0,0 +1,115 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_ADL_PACER
+#define _H_ADL_PACER
+
+#include "status.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* frame time buckets are 1ms wide, the last also holds everything longer */
+#define ADL_PACER_FRAME_BUCKETS 48
+
+/* overshoot buckets, bucket 0 counts under 1us and bucket n [2^(n-1), 2^n)us,
+ * the last also holds everything longer */
+#define ADL_PACER_OVERSHOOT_BUCKETS 20
+
+typedef struct
+{
+  uint64_t frames;  // number of calls to adlFramePacerWait
+  uint64_t missed;  // frames whose deadline had passed when waited on
+  uint64_t skipped; // deadlines dropped to get back on schedule
+  uint64_t frameTime[ADL_PACER_FRAME_BUCKETS];
+  uint64_t overshoot[ADL_PACER_OVERSHOOT_BUCKETS];
+}
+ADLFramePacerStats;
+
+/* everything in the structure is private to the pacer */
+typedef struct
+{
+  uint64_t period;      // nanoseconds per frame
+  uint64_t epoch;       // deadline of frame `epochFrame`
+  uint64_t epochFrame;
+  uint64_t frame;       // the next frame to wait for
+  uint64_t lastWake;
+  bool     lock;
+  uint64_t lastPresent;
+  ADLFramePacerStats stats;
+}
+ADLFramePacer;
+
+/**
+ * Initialize a frame pacer
+ *
+ * @param pacer    The pacer to initialize
+ * @param periodNS The nominal time between frames
+ *
+ * Deadlines are scheduled from a fixed epoch at a multiple of the period so
+ * that the time taken by each frame does not accumulate as drift.
+ */
+ADL_STATUS adlFramePacerInit(ADLFramePacer * pacer, uint64_t periodNS);
+
+/**
+ * Wait for the next frame deadline
+ *
+ * @param pacer The frame pacer
+ * @param frame Set to the index of the frame to render, may be NULL
+ *
+ * If the deadline has already passed the frame is counted as missed and the
+ * call returns immediately, any deadlines that passed entirely are skipped so
+ * the following frame is back on schedule instead of rendering a burst of
+ * frames to catch up.
+ */
+void adlFramePacerWait(ADLFramePacer * pacer, uint64_t * frame);
+
+/**
+ * Lock the pacer to the observed present period
+ *
+ * When enabled the period and phase are adjusted from the timestamps passed to
+ * adlFramePacerPresented, the nominal period should be close to the display's.
+ */
+void adlFramePacerSetLock(ADLFramePacer * pacer, bool lock);
+
+/**
+ * Report when a frame was presented
+ *
+ * @param pacer   The frame pacer
+ * @param clockNS The present or vblank time in adlGetClockNS time, or the time
+ *                a blocking swap returned
+ */
+void adlFramePacerPresented(ADLFramePacer * pacer, uint64_t clockNS);
+
+/**
+ * Get the current period, this differs from the nominal period when locked
+ */
+uint64_t adlFramePacerGetPeriod(const ADLFramePacer * pacer);
+
+void adlFramePacerGetStats(const ADLFramePacer * pacer,
+    ADLFramePacerStats * stats);
+void adlFramePacerResetStats(ADLFramePacer * pacer);
+
+#endif
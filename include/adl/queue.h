@@ -0,0 +1,142 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_ADL_QUEUE
+#define _H_ADL_QUEUE
+
+#include "status.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* members written by different threads are kept on separate cache lines */
+#define ADL_CACHE_LINE 64
+
+typedef enum
+{
+  /* allow the *Wait functions, pushes and pops then also check for sleeping
+   * threads to wake which costs a full memory barrier each */
+  ADL_QUEUE_BLOCKING = 0x1
+}
+ADLQueueFlags;
+
+/* everything in the structures is private to the queue */
+typedef struct
+{
+  alignas(ADL_CACHE_LINE) atomic_uint tail;
+  unsigned int cachedHead; // the producer's last view of `head`
+
+  alignas(ADL_CACHE_LINE) atomic_uint head;
+  unsigned int cachedTail; // the consumer's last view of `tail`
+
+  alignas(ADL_CACHE_LINE) uint8_t * items;
+  unsigned int mask;
+  size_t       itemSize;
+  unsigned int flags;
+
+  alignas(ADL_CACHE_LINE) atomic_uint futex;
+  atomic_uint waiters;
+}
+ADLSPSCQueue;
+
+typedef struct
+{
+  alignas(ADL_CACHE_LINE) atomic_uint tail;
+  alignas(ADL_CACHE_LINE) atomic_uint head;
+
+  /* each slot's sequence tells producers and consumers whose turn it is */
+  alignas(ADL_CACHE_LINE) atomic_uint * seq;
+  uint8_t    * items;
+  unsigned int mask;
+  size_t       itemSize;
+  unsigned int flags;
+
+  alignas(ADL_CACHE_LINE) atomic_uint futex;
+  atomic_uint waiters;
+}
+ADLMPMCQueue;
+
+/**
+ * Initialize a bounded single producer, single consumer queue
+ *
+ * @param queue    The queue to initialize
+ * @param capacity The number of items, rounded up to a power of two
+ * @param itemSize The size of each item in bytes
+ * @param flags    ADLQueueFlags
+ *
+ * Push and pop are wait-free, only one thread may push and only one thread may
+ * pop at a time.
+ */
+ADL_STATUS adlSPSCQueueInit(ADLSPSCQueue * queue, unsigned int capacity,
+    size_t itemSize, unsigned int flags);
+void adlSPSCQueueFree(ADLSPSCQueue * queue);
+
+/* copy the item into the queue, returns false if the queue is full */
+bool adlSPSCQueuePush(ADLSPSCQueue * queue, const void * item);
+
+/* copy the oldest item out of the queue, returns false if it is empty */
+bool adlSPSCQueuePop(ADLSPSCQueue * queue, void * item);
+
+/**
+ * Blocking push and pop, the queue must have been created with
+ * ADL_QUEUE_BLOCKING
+ *
+ * `timeoutNS` zero does not block and negative waits forever, as with the
+ * adl/sync.h primitives ADL_ERR_BUSY is returned if a zero timeout would have
+ * blocked and ADL_ERR_TIMEOUT if there was no room or no item in time.
+ */
+ADL_STATUS adlSPSCQueuePushWait(ADLSPSCQueue * queue, const void * item,
+    int64_t timeoutNS);
+ADL_STATUS adlSPSCQueuePopWait(ADLSPSCQueue * queue, void * item,
+    int64_t timeoutNS);
+
+/**
+ * Initialize a bounded multiple producer, multiple consumer queue
+ *
+ * @param queue    The queue to initialize
+ * @param capacity The number of items, rounded up to a power of two
+ * @param itemSize The size of each item in bytes
+ * @param flags    ADLQueueFlags
+ *
+ * Producers and consumers claim slots with a single compare and swap and are
+ * ordered by a per slot sequence number, so the queue is lock-free but a
+ * thread preempted mid-copy delays the consumer of that slot.
+ */
+ADL_STATUS adlMPMCQueueInit(ADLMPMCQueue * queue, unsigned int capacity,
+    size_t itemSize, unsigned int flags);
+void adlMPMCQueueFree(ADLMPMCQueue * queue);
+
+bool adlMPMCQueuePush(ADLMPMCQueue * queue, const void * item);
+bool adlMPMCQueuePop (ADLMPMCQueue * queue, void * item);
+
+ADL_STATUS adlMPMCQueuePushWait(ADLMPMCQueue * queue, const void * item,
+    int64_t timeoutNS);
+ADL_STATUS adlMPMCQueuePopWait(ADLMPMCQueue * queue, void * item,
+    int64_t timeoutNS);
+
+#endif
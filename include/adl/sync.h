@@ -0,0 +1,103 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_ADL_SYNC
+#define _H_ADL_SYNC
+
+#include "status.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Blocking primitives, the wait functions follow adlThreadJoin's timeout
+ * convention: `timeout` is in milliseconds (nanoseconds for the *NS variants),
+ * zero does not block and returns ADL_ERR_BUSY if the wait would block and a
+ * negative timeout waits forever, ADL_ERR_TIMEOUT is returned if it expires.
+ *
+ * Uncontended posts and waits are a single atomic operation, the kernel is
+ * only entered to sleep or to wake a thread that is sleeping.
+ *
+ * Everything in the structures is private, use the init functions.
+ */
+
+typedef struct
+{
+  atomic_uint count;
+  atomic_uint waiters;
+}
+ADLSemaphore;
+
+void adlSemaphoreInit(ADLSemaphore * sem, unsigned int count);
+
+/* increment the count releasing one waiter */
+void adlSemaphorePost(ADLSemaphore * sem);
+
+/* wait for the count to be non-zero and decrement it */
+ADL_STATUS adlSemaphoreWait  (ADLSemaphore * sem, int timeout);
+ADL_STATUS adlSemaphoreWaitNS(ADLSemaphore * sem, int64_t timeoutNS);
+
+typedef struct
+{
+  atomic_uint state;
+  atomic_uint waiters;
+  bool        manual;
+}
+ADLSignal;
+
+/**
+ * Initialize a signal
+ *
+ * @param signal The signal to initialize
+ * @param manual If true the signal stays set releasing every waiter until it
+ *               is reset, otherwise each set releases a single waiter and the
+ *               signal resets as that waiter returns
+ * @param set    The initial state
+ */
+void adlSignalInit(ADLSignal * signal, bool manual, bool set);
+void adlSignalSet  (ADLSignal * signal);
+void adlSignalReset(ADLSignal * signal);
+
+ADL_STATUS adlSignalWait  (ADLSignal * signal, int timeout);
+ADL_STATUS adlSignalWaitNS(ADLSignal * signal, int64_t timeoutNS);
+
+typedef struct
+{
+  atomic_uint count;
+  atomic_uint waiters;
+}
+ADLLatch;
+
+/* a single use barrier that opens once counted down `count` times */
+void adlLatchInit(ADLLatch * latch, unsigned int count);
+
+/* count down by `n`, releasing every waiter when the count reaches zero */
+void adlLatchCountDown(ADLLatch * latch, unsigned int n);
+
+ADL_STATUS adlLatchWait  (ADLLatch * latch, int timeout);
+ADL_STATUS adlLatchWaitNS(ADLLatch * latch, int64_t timeoutNS);
+
+#endif
@@ -27,10 +27,43 @@
 
 #include "status.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "platform.h"
 
 typedef void * (*ADLThreadFn)(ADLThread * thread, void * udata);
 
+typedef enum
+{
+  ADL_THREAD_SCHED_DEFAULT, // the normal time sharing policy
+  ADL_THREAD_SCHED_FIFO,    // real-time, runs until it blocks or yields
+  ADL_THREAD_SCHED_RR       // real-time, round robin between equal priorities
+}
+ADLThreadSched;
+
+/* zero initialize and set only the attributes required */
+typedef struct
+{
+  const char   * name;      // truncated to the platform's limit, may be NULL
+  uint64_t       affinity;  // bit n allows CPU n, zero for any CPU
+  ADLThreadSched sched;
+  int            priority;  // real-time priority, clamped to the valid range
+  int            nice;      // for the default policy or if real-time is denied
+  size_t         stackSize; // zero for the default
+}
+ADLThreadAttr;
+
+/* the attributes that were applied */
+typedef enum
+{
+  ADL_THREAD_APPLIED_NAME     = 0x01,
+  ADL_THREAD_APPLIED_AFFINITY = 0x02,
+  ADL_THREAD_APPLIED_SCHED    = 0x04,
+  ADL_THREAD_APPLIED_NICE     = 0x08,
+  ADL_THREAD_APPLIED_STACK    = 0x10
+}
+ADLThreadApplied;
+
 /**
  * Create a new thread
  *
@@ -40,6 +73,24 @@ typedef void * (*ADLThreadFn)(ADLThread * thread, void * udata);
  */
 ADL_STATUS adlThreadCreate(ADLThreadFn fn, void * udata, ADLThread * result);
 
+/**
+ * Create a new thread with attributes
+ *
+ * @param fn      The thread function
+ * @param udata   Application defined data, may be NULL
+ * @param attr    The attributes, may be NULL for the defaults
+ * @param result  The new thread
+ * @param applied Set to the ADLThreadApplied flags of the attributes that took
+ *                effect, may be NULL
+ *
+ * The attributes are applied by the new thread before `fn` is called. Those
+ * that the process is not permitted to set do not fail the call, if a
+ * real-time policy is denied the thread keeps the default policy and the nice
+ * value is applied instead. Check `applied` to see what took effect.
+ */
+ADL_STATUS adlThreadCreateEx(ADLThreadFn fn, void * udata,
+    const ADLThreadAttr * attr, ADLThread * result, unsigned int * applied);
+
 /**
  * Join a running or finished thread
  *
@@ -30,16 +30,50 @@
 #include "platform.h"
 
 /**
- * The callback from the timer
+ * The callback from the timer, return false to stop the timer
  *
- * @Note: Under linux this is called via a system signal and usage of `adl`
- * methods from inside this callback should be avoided to prevent deadlocks.
+ * Called from ADL's timer thread which is started with the first timer, the
+ * callbacks of all timers run on this one thread. Once adlTimerDestroy returns
+ * the callback is not running and will not be called again.
+ *
+ * Timers may be created and destroyed from the callback. Any other ADL call
+ * such as a window or image function races with the thread processing events
+ * unless thread-safe mode has been enabled with adlSetThreadSafe(true).
  */
 typedef bool (*ADLTimerFn)(void * udata);
 
+/**
+ * Create a timer that calls `fn` every `intervalNS` on the timer thread
+ *
+ * The `result` storage must remain valid until the timer is destroyed
+ */
 ADL_STATUS adlTimerCreate(const unsigned int intervalNS, ADLTimerFn fn,
     void * udata, ADLTimer * result);
 
+/**
+ * Create a timer that is delivered every `intervalNS` as an ADL_EVENT_TIMER
+ * from adlProcessEvent on the thread processing events
+ *
+ * If the event loop falls behind the expirations are merged into one event,
+ * see ADLEventTimer. The `result` storage must remain valid until the timer is
+ * destroyed.
+ */
+ADL_STATUS adlTimerCreateEvent(const unsigned int intervalNS, void * udata,
+    ADLTimer * result);
+
+/**
+ * Allow the timer to expire up to `slackNS` late so that it can share a wakeup
+ * with other timers due around the same time, takes effect from the next
+ * expiry. The default is no slack.
+ */
+void adlTimerSetSlack(ADLTimer * timer, unsigned int slackNS);
+
+/**
+ * Returns the number of expirations that were merged or missed because the
+ * callback or event loop was too slow
+ */
+uint64_t adlTimerGetOverruns(const ADLTimer * timer);
+
 void adlTimerDestroy(ADLTimer * timer);
 
 #endif
@@ -0,0 +1,56 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_ADL_TRACE
+#define _H_ADL_TRACE
+
+#include "status.h"
+
+/**
+ * Start recording trace spans
+ *
+ * Each thread records into it's own buffer which keeps the most recent spans,
+ * starting again discards everything recorded so far.
+ */
+ADL_STATUS adlTraceStart(void);
+
+/**
+ * Stop recording trace spans
+ */
+ADL_STATUS adlTraceStop(void);
+
+/**
+ * Write the recorded spans to `path` as Chrome trace event JSON
+ *
+ * @param path The file to write, it is replaced if it exists
+ *
+ * The output can be loaded into chrome://tracing or the Perfetto UI. The
+ * buffers are read without locking, the output is only coherent once
+ * adlTraceStop has been called and spans already in progress have completed,
+ * dumping while recording may emit partially overwritten spans.
+ */
+ADL_STATUS adlTraceDump(const char * path);
+
+#endif
@@ -23,6 +23,7 @@
 */
 
 #ifndef _H_ADL_UTIL
+#define _H_ADL_UTIL
 
 #include <stdint.h>
 
@@ -32,4 +33,46 @@ uint64_t adlGetClockNS(void);
 void adlWaitUntilMS(uint64_t clockMS);
 void adlWaitUntilNS(uint64_t clockNS);
 
+/* wake-up error buckets, bucket 0 counts errors under 1ns and bucket n errors
+ * of [2^(n-1), 2^n)ns, the last also holds everything longer */
+#define ADL_WAIT_BUCKETS 24
+
+typedef struct
+{
+  uint64_t waits;
+  uint64_t spinNS;   // total time spent spinning
+  uint64_t marginNS; // how long before the deadline the sleep currently ends
+
+  /* how late adlWaitUntilNSPrecise returned */
+  uint64_t late[ADL_WAIT_BUCKETS];
+
+  /* how far the sleep overshot the margin, the margin must cover this for the
+   * spin to absorb it */
+  uint64_t oversleep[ADL_WAIT_BUCKETS];
+}
+ADLWaitStats;
+
+/* sleep until a margin before `clockNS` then spin until it. The margin adapts
+ * to the measured sleep overshoot and is capped by the spin budget */
+void adlWaitUntilNSPrecise(uint64_t clockNS);
+
+/* limit the time spent spinning by each precise wait, default 2ms */
+void adlSetWaitSpinBudget(uint64_t maxNS);
+
+void adlGetWaitStats(ADLWaitStats * stats);
+void adlResetWaitStats(void);
+
+/* get the number of online CPUs, always returns at least 1 */
+unsigned int adlGetCPUCount(void);
+
+/* hint to the CPU that the caller is busy waiting */
+static inline void adlCPURelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ volatile("yield");
+#endif
+}
+
 #endif
@@ -28,6 +28,7 @@
 #include "adl/status.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum
 {
@@ -91,12 +92,31 @@ struct _ADLWindow
   int          x, y;
   unsigned int w, h;
   bool         visible;
+  bool         focused;
 
   bool haveMousePos;
   int  mouseX, mouseY;
   bool mouseWarping, mouseWarp;
 };
 
+/**
+ * A consistent snapshot of the window's state, see adlWindowGetState
+ */
+typedef struct
+{
+  uint32_t     serial; // incremented every time the state is published
+  int          x, y;
+  unsigned int w, h;
+  bool         visible;
+  bool         focused;
+
+  // the latest pointer position, only valid if havePointer is set
+  bool         havePointer;
+  int          pointerX, pointerY;
+  unsigned int buttons; // bitfield of the held ADLMouseButton buttons
+}
+ADLWindowState;
+
 ADL_STATUS adlWindowCreate(const ADLWindowDef def, ADLWindow ** result);
 ADL_STATUS adlWindowDestroy(ADLWindow ** window);
 ADL_STATUS adlWindowShow(ADLWindow * window);
@@ -107,4 +127,14 @@ ADL_STATUS adlWindowSetGrab(ADLWindow * window, bool enable);
 ADL_STATUS adlWindowSetRelative(ADLWindow * window, bool enable);
 ADL_STATUS adlWindowSetFocus(ADLWindow * window);
 
+/**
+ * Get the window's state as last published by the event loop
+ *
+ * The state is published whenever an event changes it and is read without
+ * taking any locks or calling the platform, so a render thread can latch the
+ * latest pointer position right before it submits a frame. The window must
+ * not be destroyed during the call.
+ */
+ADL_STATUS adlWindowGetState(ADLWindow * window, ADLWindowState * state);
+
 #endif
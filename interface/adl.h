@@ -37,6 +37,9 @@
 
 /* platform functions */
 typedef ADL_STATUS (*ADLPf)(void);
+
+/* windows are looked up with windowFindLocked, the event's window is returned
+ * locked and is unlocked by ADL once the event has been translated */
 typedef ADL_STATUS (*ADLPfProcessEvent)
   (int timeout, ADLEvent * event);
 
@@ -53,6 +56,10 @@ typedef ADL_STATUS (*ADLPfImageGetSupported)(const ADLImageBackend ** result);
 typedef ADL_STATUS (*ADLPfImageCreate      )(ADLWindow * window,
     const ADLImageDef def, ADLImage * result);
 typedef ADL_STATUS (*ADLPfImage            )(ADLImage * result);
+typedef ADL_STATUS (*ADLPfImageRects       )(ADLImage * image,
+    const void * buffer, const ADLRect * rects, unsigned int count);
+typedef ADL_STATUS (*ADLPfImagePresentAt   )(ADLImage * image, int x, int y,
+    const ADLRect * src);
 
 /* pointer functions */
 typedef ADL_STATUS (*ADLPfPointer)(ADLWindow * window, int x, int y);
@@ -67,15 +74,17 @@ typedef ADL_STATUS (*ADLPfEGLCreateWindowSurface)(EGLDisplay * display,
   EGLSurface * surface);
 #endif
 
+/* ADL_FIELD is invoked for every member, ADL_DATA_FIELD is for the members
+ * that are not entry points and by default also expands to ADL_FIELD */
 #define ADL_PLATFORM_FIELDS \
-  ADL_FIELD(const char *     , name        ) \
+  ADL_DATA_FIELD(const char *, name) \
   ADL_FIELD(ADLPf            , test        ) \
   ADL_FIELD(ADLPf            , init        ) \
   ADL_FIELD(ADLPf            , deinit      ) \
   ADL_FIELD(ADLPfProcessEvent, processEvent) \
   ADL_FIELD(ADLPf            , flush       ) \
   \
-  ADL_FIELD(size_t            , windowDataSize    ) \
+  ADL_DATA_FIELD(size_t, windowDataSize) \
   ADL_FIELD(ADLPfWindowCreate , windowCreate      ) \
   ADL_FIELD(ADLPfWindow       , windowDestroy     ) \
   ADL_FIELD(ADLPfWindow       , windowShow        ) \
@@ -87,11 +96,13 @@ typedef ADL_STATUS (*ADLPfEGLCreateWindowSurface)(EGLDisplay * display,
   ADL_FIELD(ADLPfWindow       , windowSetFocus    ) \
   ADL_FIELD(ADLPfWindowEvent  , windowEvent       ) \
   \
-  ADL_FIELD(size_t                , imageDataSize    ) \
+  ADL_DATA_FIELD(size_t, imageDataSize) \
   ADL_FIELD(ADLPfImageGetSupported, imageGetSupported) \
   ADL_FIELD(ADLPfImageCreate      , imageCreate      ) \
   ADL_FIELD(ADLPfImage            , imageDestroy     ) \
   ADL_FIELD(ADLPfImage            , imageUpdate      ) \
+  ADL_FIELD(ADLPfImageRects       , imageUpdateRects ) \
+  ADL_FIELD(ADLPfImagePresentAt   , imagePresentAt   ) \
   \
   ADL_FIELD(ADLPfPointer      , pointerWarp     ) \
   ADL_FIELD(ADLPfWindowSetBool, pointerVisible  ) \
@@ -101,6 +112,7 @@ typedef ADL_STATUS (*ADLPfEGLCreateWindowSurface)(EGLDisplay * display,
   ADL_EGL_FIELD(ADLPfEGLCreateWindowSurface, eglCreateWindowSurface)
 
 #define ADL_FIELD(type, name) type name;
+#define ADL_DATA_FIELD(type, name) ADL_FIELD(type, name)
 
 #if defined(ADL_HAS_EGL)
   #define ADL_EGL_FIELD(type, name) ADL_FIELD(type, name)
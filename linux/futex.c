@@ -0,0 +1,62 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "src/futex.h"
+#include "src/adl.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+bool futexWait(atomic_uint * addr, unsigned int expected, uint64_t deadlineNS)
+{
+  /* the bitset variant takes an absolute CLOCK_MONOTONIC timeout, so a wait
+   * that is interrupted and restarted does not extend the deadline */
+  struct timespec ts;
+  struct timespec * timeout = NULL;
+  if (deadlineNS != FUTEX_FOREVER)
+  {
+    /* adlGetClockNS is relative to adlInitialize */
+    deadlineNS += adl.startTime * 1000000ULL;
+    ts.tv_sec  = deadlineNS / 1000000000ULL;
+    ts.tv_nsec = deadlineNS % 1000000000ULL;
+    timeout    = &ts;
+  }
+
+  if (syscall(SYS_futex, addr, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG,
+        expected, timeout, NULL, FUTEX_BITSET_MATCH_ANY) == 0)
+    return true;
+
+  return errno != ETIMEDOUT;
+}
+
+void futexWake(atomic_uint * addr, bool all)
+{
+  syscall(SYS_futex, addr, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, all ? INT_MAX : 1,
+      NULL, NULL, 0);
+}
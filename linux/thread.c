@@ -23,14 +23,167 @@
 */
 
 #include "adl/thread.h"
+#include "adl/logging.h"
 #include <pthread.h>
 #include <stdatomic.h>
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <string.h>
+#include <sys/resource.h>
+
+/* the kernel limits thread names to 16 bytes including the terminator */
+#define THREAD_NAME_MAX 16
+
+/* handed to the new thread, lives on the creator's stack until `ready` */
+typedef struct
+{
+  ADLThread           * thread;
+  const ADLThreadAttr * attr;
+  unsigned int          applied;
+  sem_t                 ready;
+}
+ThreadStart;
 
 static void * threadFn(void * opaque)
 {
   ADLThread * thread = (ADLThread *)opaque;
-  return thread->function(thread, opaque);
+  return thread->function(thread, thread->udata);
+}
+
+static unsigned int threadApply(const ADLThreadAttr * attr)
+{
+  unsigned int applied = 0;
+
+  if (attr->name)
+  {
+    char name[THREAD_NAME_MAX];
+    strncpy(name, attr->name, sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    if (pthread_setname_np(pthread_self(), name) == 0)
+      applied |= ADL_THREAD_APPLIED_NAME;
+  }
+
+  if (attr->affinity)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(unsigned int i = 0; i < 64; ++i)
+      if (attr->affinity & (1ULL << i))
+        CPU_SET(i, &set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+      applied |= ADL_THREAD_APPLIED_AFFINITY;
+    else
+      ADL_WARN(ADL_ERR_PLATFORM, "failed to set the affinity of thread %s",
+          attr->name ? attr->name : "(unnamed)");
+  }
+
+  bool realtime = false;
+  if (attr->sched != ADL_THREAD_SCHED_DEFAULT)
+  {
+    const int policy =
+      attr->sched == ADL_THREAD_SCHED_FIFO ? SCHED_FIFO : SCHED_RR;
+    const int min = sched_get_priority_min(policy);
+    const int max = sched_get_priority_max(policy);
+
+    struct sched_param param =
+    {
+      .sched_priority =
+        attr->priority < min ? min :
+        attr->priority > max ? max :
+        attr->priority
+    };
+
+    /* usually EPERM without CAP_SYS_NICE or an RLIMIT_RTPRIO */
+    const int ret = pthread_setschedparam(pthread_self(), policy, &param);
+    if (ret == 0)
+    {
+      realtime = true;
+      applied |= ADL_THREAD_APPLIED_SCHED;
+    }
+    else
+      ADL_WARN(ADL_ERR_PLATFORM, "real-time scheduling denied for thread %s "
+          "(%s), using nice %d", attr->name ? attr->name : "(unnamed)",
+          strerror(ret), attr->nice);
+  }
+
+  /* nice values are per thread on Linux, `who` zero is the calling thread */
+  if (!realtime && attr->nice)
+  {
+    if (setpriority(PRIO_PROCESS, 0, attr->nice) == 0)
+      applied |= ADL_THREAD_APPLIED_NICE;
+    else
+      ADL_WARN(ADL_ERR_PLATFORM, "failed to set nice %d for thread %s",
+          attr->nice, attr->name ? attr->name : "(unnamed)");
+  }
+
+  return applied;
+}
+
+static void * threadStartFn(void * opaque)
+{
+  ThreadStart * start  = (ThreadStart *)opaque;
+  ADLThread   * thread = start->thread;
+
+  start->applied |= threadApply(start->attr);
+  sem_post(&start->ready);
+
+  return thread->function(thread, thread->udata);
+}
+
+ADL_STATUS adlThreadCreateEx(ADLThreadFn fn, void * udata,
+    const ADLThreadAttr * attr, ADLThread * result, unsigned int * applied)
+{
+  if (applied)
+    *applied = 0;
+
+  if (!attr)
+    return adlThreadCreate(fn, udata, result);
+
+  ThreadStart start =
+  {
+    .thread = result,
+    .attr   = attr
+  };
+
+  pthread_attr_t pattr;
+  if (pthread_attr_init(&pattr) != 0)
+    return ADL_ERR_PLATFORM;
+
+  if (attr->stackSize)
+  {
+    size_t size = attr->stackSize;
+    if (size < PTHREAD_STACK_MIN)
+      size = PTHREAD_STACK_MIN;
+
+    if (pthread_attr_setstacksize(&pattr, size) == 0)
+      start.applied |= ADL_THREAD_APPLIED_STACK;
+    else
+      ADL_WARN(ADL_ERR_PLATFORM, "invalid stack size %zu", attr->stackSize);
+  }
+
+  sem_init(&start.ready, 0, 0);
+  result->function = fn;
+  result->udata    = udata;
+  atomic_store(&result->running, true);
+
+  const int ret = pthread_create(&result->thread, &pattr, threadStartFn, &start);
+  pthread_attr_destroy(&pattr);
+  if (ret != 0)
+  {
+    sem_destroy(&start.ready);
+    return ADL_ERR_PLATFORM;
+  }
+
+  while(sem_wait(&start.ready) != 0 && errno == EINTR)
+    continue;
+  sem_destroy(&start.ready);
+
+  if (applied)
+    *applied = start.applied;
+  return ADL_OK;
 }
 
 ADL_STATUS adlThreadCreate(ADLThreadFn fn, void * udata, ADLThread * result)
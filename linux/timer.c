@@ -22,58 +22,427 @@
   SOFTWARE.
 */
 
+
 #include "adl/timer.h"
+#include "src/timer.h"
+#include "src/event.h"
+#include "src/trace.h"
+#include "src/wheel.h"
 
-#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
 #include <time.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+/* wheel ticks are 2^16ns (~65us) */
+#define TICK_SHIFT 16
+
+/* every timer is kept in one wheel driven by a single timerfd that is armed
+ * for the wheel's next tick and serviced by the timer thread. Timers delivered
+ * through the event loop are moved to the pending list and the eventfd is
+ * signalled for the platform to wake on. Expired callback timers are moved to
+ * the fire list and called once the lock has been dropped */
+static struct
+{
+  pthread_mutex_t lock;
+  /* signalled when the callback in `calling` returns */
+  pthread_cond_t  called;
+
+  int        timerFd;
+  int        eventFd;
+  uint64_t   armed;   // the tick the timerfd is armed for
+  bool       running;
+  ADLThread  thread;
+  ADLWheel   wheel;
+
+  ADLTimer * pendHead;
+  ADLTimer * pendTail;
+
+  ADLTimer * fireHead;
+  ADLTimer * fireTail;
+  ADLTimer * calling;
+}
+timers =
+{
+  .lock    = PTHREAD_MUTEX_INITIALIZER,
+  .called  = PTHREAD_COND_INITIALIZER,
+  .timerFd = -1,
+  .eventFd = -1,
+  .armed   = UINT64_MAX
+};
 
-static void timerHandler(int sig, siginfo_t * si, void * uc)
+static _Thread_local bool onTimerThread;
+
+static uint64_t nowNS(void)
 {
-  if (sig != SIGRTMIN || !si->si_value.sival_ptr)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* arm the timerfd for the wheel's next tick if it is not already */
+static void timerArm(void)
+{
+  const uint64_t next = adlWheelNext(&timers.wheel);
+  if (next == timers.armed)
     return;
 
-  ADLTimer * timer = (ADLTimer *)si->si_value.sival_ptr;
-  if (!((ADLTimerFn)timer->timerFn)(timer->udata))
-    timer_delete(timer->timerID);
+  struct itimerspec its = { 0 };
+  if (next != UINT64_MAX)
+  {
+    const uint64_t ns = next << TICK_SHIFT;
+    its.it_value.tv_sec  = ns / 1000000000ULL;
+    its.it_value.tv_nsec = ns % 1000000000ULL;
+  }
+
+  timerfd_settime(timers.timerFd, TFD_TIMER_ABSTIME, &its, NULL);
+  timers.armed = next;
 }
 
-ADL_STATUS adlTimerCreate(const unsigned int intervalNS, ADLTimerFn fn,
-    void * udata, ADLTimer * result)
+/* schedule the timer's deadline, rounding it up within the slack to a
+ * boundary that nearby timers are likely to share */
+static void timerSchedule(ADLTimer * timer)
 {
-  struct sigaction sa =
+  uint64_t expires = timer->deadline;
+  if (timer->slack)
   {
-    .sa_flags     = SA_SIGINFO,
-    .sa_sigaction = timerHandler
-  };
+    const uint64_t limit = expires + timer->slack;
+    const uint64_t diff  = expires ^ limit;
+    expires = limit & ~((1ULL << (63 - __builtin_clzll(diff))) - 1);
+  }
+
+  timer->expires = (expires + (1ULL << TICK_SHIFT) - 1) >> TICK_SHIFT;
+  adlWheelInsert(&timers.wheel, timer);
+}
+
+static void pendingRemove(ADLTimer * timer)
+{
+  if (timer->pendPrev)
+    timer->pendPrev->pendNext = timer->pendNext;
+  else
+    timers.pendHead = timer->pendNext;
+
+  if (timer->pendNext)
+    timer->pendNext->pendPrev = timer->pendPrev;
+  else
+    timers.pendTail = timer->pendPrev;
 
-  result->timerFn = fn;
-  result->udata   = udata;
+  timer->pendNext = NULL;
+  timer->pendPrev = NULL;
+  timer->pending  = 0;
+
+  /* nothing left to deliver, stop the platform from waking */
+  if (!timers.pendHead)
+  {
+    eventfd_t value;
+    eventfd_read(timers.eventFd, &value);
+  }
+}
+
+static void fireRemove(ADLTimer * timer)
+{
+  ADLTimer * prev = NULL;
+  for(ADLTimer * t = timers.fireHead; t; prev = t, t = t->fireNext)
+    if (t == timer)
+    {
+      if (prev)
+        prev->fireNext = t->fireNext;
+      else
+        timers.fireHead = t->fireNext;
+
+      if (timers.fireTail == t)
+        timers.fireTail = prev;
+      break;
+    }
+
+  timer->fireNext = NULL;
+  timer->firing   = false;
+}
+
+static void timerExpire(ADLTimer * timer, void * udata)
+{
+  const uint64_t now         = *(const uint64_t *)udata;
+  const uint64_t expirations = 1 + (now - timer->deadline) / timer->interval;
+
+  timer->deadline += expirations * timer->interval;
+  timerSchedule(timer);
+
+  if (timer->event)
+  {
+    /* still waiting to be delivered, merge the expirations */
+    if (timer->pending)
+    {
+      timer->overruns += expirations;
+      timer->pending  += expirations;
+      return;
+    }
+
+    timer->overruns += expirations - 1;
+    timer->pending   = expirations;
+    timer->pendPrev  = timers.pendTail;
+    if (timers.pendTail)
+      timers.pendTail->pendNext = timer;
+    else
+    {
+      timers.pendHead = timer;
+      eventfd_write(timers.eventFd, 1);
+    }
+    timers.pendTail = timer;
+    return;
+  }
+
+  /* the callback has not been called for the last expiry yet */
+  if (timer->firing)
+  {
+    timer->overruns += expirations;
+    return;
+  }
+
+  timer->overruns += expirations - 1;
+  timer->firing    = true;
+  timer->fireNext  = NULL;
+  if (timers.fireTail)
+    timers.fireTail->fireNext = timer;
+  else
+    timers.fireHead = timer;
+  timers.fireTail = timer;
+}
+
+/* call the expired callbacks without holding the lock so they can not stall
+ * the event loop, the caller must hold the lock */
+static void timerFire(void)
+{
+  ADLTimer * timer;
+  while((timer = timers.fireHead))
+  {
+    timers.fireHead = timer->fireNext;
+    if (!timers.fireHead)
+      timers.fireTail = NULL;
+    timer->fireNext = NULL;
+    timer->firing   = false;
+
+    ADLTimerFn fn    = (ADLTimerFn)timer->timerFn;
+    void     * udata = timer->udata;
+    timers.calling = timer;
+    pthread_mutex_unlock(&timers.lock);
+
+    bool keep;
+    {
+      ADL_TRACE_SCOPE("timer");
+      keep = fn(udata);
+    }
+
+    pthread_mutex_lock(&timers.lock);
+
+    /* calling is cleared if the callback destroyed the timer */
+    if (!keep && timers.calling == timer)
+    {
+      adlWheelRemove(&timers.wheel, timer);
+      timer->active = false;
+    }
+
+    timers.calling = NULL;
+    pthread_cond_broadcast(&timers.called);
+  }
+}
+
+static void * timerThread(ADLThread * thread, void * udata)
+{
+  onTimerThread = true;
+  while(adlThreadIsRunning(thread))
+  {
+    uint64_t count;
+    if (read(timers.timerFd, &count, sizeof(count)) < 0 && errno != EINTR &&
+        errno != EAGAIN)
+    {
+      ADL_ERROR(ADL_ERR_PLATFORM, "timerfd read failed: %d", errno);
+      break;
+    }
 
-  sigemptyset(&sa.sa_mask);
-  if (sigaction(SIGRTMIN, &sa, NULL) == -1)
+    pthread_mutex_lock(&timers.lock);
+    const uint64_t now = nowNS();
+    adlWheelAdvance(&timers.wheel, now >> TICK_SHIFT, timerExpire,
+        (void *)&now);
+
+    /* the timerfd is disarmed once it has fired */
+    timers.armed = UINT64_MAX;
+    timerArm();
+
+    timerFire();
+    pthread_mutex_unlock(&timers.lock);
+  }
+
+  return NULL;
+}
+
+static ADL_STATUS timerStart(void)
+{
+  if (timers.running)
+    return ADL_OK;
+
+  if ((timers.timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0 ||
+      (timers.eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+  {
+    ADL_ERROR(ADL_ERR_PLATFORM, "timer setup failed: %d", errno);
+    if (timers.timerFd >= 0)
+      close(timers.timerFd);
+    timers.timerFd = -1;
     return ADL_ERR_PLATFORM;
+  }
+
+  adlWheelInit(&timers.wheel, nowNS() >> TICK_SHIFT);
+  timers.armed = UINT64_MAX;
 
-  struct sigevent te =
+  ADL_STATUS status;
+  const ADLThreadAttr attr = { .name = "adl-timer" };
+  if ((status = adlThreadCreateEx(timerThread, NULL, &attr, &timers.thread,
+      NULL)) != ADL_OK)
   {
-    .sigev_notify          = SIGEV_SIGNAL,
-    .sigev_signo           = SIGRTMIN,
-    .sigev_value.sival_ptr = result,
+    close(timers.timerFd);
+    close(timers.eventFd);
+    timers.timerFd = -1;
+    timers.eventFd = -1;
+    return status;
+  }
+
+  timers.running = true;
+  return ADL_OK;
+}
+
+static ADL_STATUS timerCreate(const unsigned int intervalNS, ADLTimerFn fn,
+    void * udata, bool event, ADLTimer * result)
+{
+  if (!intervalNS || !result || (!event && !fn))
+    return ADL_ERR_INVALID_ARGUMENT;
+
+  *result = (ADLTimer){
+    .timerFn  = fn,
+    .udata    = udata,
+    .event    = event,
+    .active   = true,
+    .interval = intervalNS
   };
-  timer_create(CLOCK_REALTIME, &te, &result->timerID);
 
-  struct itimerspec its =
+  pthread_mutex_lock(&timers.lock);
+
+  ADL_STATUS status;
+  if ((status = timerStart()) != ADL_OK)
   {
-    .it_interval.tv_sec  = intervalNS / 1000000000U,
-    .it_interval.tv_nsec = intervalNS - (intervalNS / 1000000000U * 1000000000U),
-    .it_value.tv_sec     = intervalNS / 1000000000U,
-    .it_value.tv_nsec    = intervalNS - (intervalNS / 1000000000U * 1000000000U)
-  };
-  timer_settime(result->timerID, 0, &its, NULL);
+    pthread_mutex_unlock(&timers.lock);
+    result->active = false;
+    return status;
+  }
+
+  result->deadline = nowNS() + intervalNS;
+  timerSchedule(result);
+  timerArm();
 
+  pthread_mutex_unlock(&timers.lock);
   return ADL_OK;
 }
 
+ADL_STATUS adlTimerCreate(const unsigned int intervalNS, ADLTimerFn fn,
+    void * udata, ADLTimer * result)
+{
+  return timerCreate(intervalNS, fn, udata, false, result);
+}
+
+ADL_STATUS adlTimerCreateEvent(const unsigned int intervalNS, void * udata,
+    ADLTimer * result)
+{
+  return timerCreate(intervalNS, NULL, udata, true, result);
+}
+
+void adlTimerSetSlack(ADLTimer * timer, unsigned int slackNS)
+{
+  pthread_mutex_lock(&timers.lock);
+  timer->slack = slackNS;
+  pthread_mutex_unlock(&timers.lock);
+}
+
+uint64_t adlTimerGetOverruns(const ADLTimer * timer)
+{
+  pthread_mutex_lock(&timers.lock);
+  const uint64_t overruns = timer->overruns;
+  pthread_mutex_unlock(&timers.lock);
+  return overruns;
+}
+
 void adlTimerDestroy(ADLTimer * timer)
 {
-  timer_delete(timer->timerID);
+  pthread_mutex_lock(&timers.lock);
+
+  /* the wheel is not re-armed, an early wakeup is harmless */
+  adlWheelRemove(&timers.wheel, timer);
+  if (timer->pending)
+    pendingRemove(timer);
+
+  if (timer->firing)
+    fireRemove(timer);
+
+  if (timer->event)
+    eventQueueClearTimer(timer);
+
+  timer->active = false;
+
+  /* destroyed from inside its own callback, let the timer thread know not to
+   * touch it again */
+  if (onTimerThread)
+  {
+    if (timers.calling == timer)
+      timers.calling = NULL;
+  }
+  else
+    while(timers.calling == timer)
+      pthread_cond_wait(&timers.called, &timers.lock);
+
+  pthread_mutex_unlock(&timers.lock);
+}
+
+bool timerPollEvent(ADLEvent * event)
+{
+  pthread_mutex_lock(&timers.lock);
+
+  ADLTimer * timer = timers.pendHead;
+  if (timer)
+  {
+    event->type                = ADL_EVENT_TIMER;
+    event->window              = NULL;
+    event->u.timer.timer       = timer;
+    event->u.timer.udata       = timer->udata;
+    event->u.timer.expirations = timer->pending;
+    pendingRemove(timer);
+  }
+
+  pthread_mutex_unlock(&timers.lock);
+  return timer != NULL;
+}
+
+int timerEventFd(void)
+{
+  return timers.eventFd;
+}
+
+void timerShutdown(void)
+{
+  if (!timers.running)
+    return;
+
+  /* wake the thread so it sees it has been stopped */
+  adlThreadStop(&timers.thread);
+  const struct itimerspec its = { .it_value.tv_nsec = 1 };
+  timerfd_settime(timers.timerFd, 0, &its, NULL);
+  adlThreadJoin(&timers.thread, NULL, -1);
+
+  pthread_mutex_lock(&timers.lock);
+  close(timers.timerFd);
+  close(timers.eventFd);
+  timers.timerFd  = -1;
+  timers.eventFd  = -1;
+  timers.running  = false;
+  timers.pendHead = NULL;
+  timers.pendTail = NULL;
+  pthread_mutex_unlock(&timers.lock);
 }
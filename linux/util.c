@@ -27,11 +27,34 @@
 
 #include <assert.h>
 #include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+/* bounds of the precise wait margin */
+#define WAIT_MIN_MARGIN   20000ULL
+#define WAIT_START_MARGIN 200000ULL
+
+static struct
+{
+  atomic_uint_fast64_t margin;
+  atomic_uint_fast64_t budget;
+  atomic_uint_fast64_t waits;
+  atomic_uint_fast64_t spinNS;
+  atomic_uint_fast64_t late     [ADL_WAIT_BUCKETS];
+  atomic_uint_fast64_t oversleep[ADL_WAIT_BUCKETS];
+}
+wait =
+{
+  .margin = WAIT_START_MARGIN,
+  .budget = 2000000ULL
+};
 
 uint64_t adlGetClockMS(void)
 {
   struct timespec time;
-  assert(clock_gettime(CLOCK_MONOTONIC, &time) == 0);
+  const int ret = clock_gettime(CLOCK_MONOTONIC, &time);
+  assert(ret == 0);
+  (void)ret;
   return ((uint64_t)time.tv_sec * 1000LLU + time.tv_nsec / 1000000LLU) -
     adl.startTime;
 }
@@ -39,7 +62,9 @@ uint64_t adlGetClockMS(void)
 uint64_t adlGetClockNS(void)
 {
   struct timespec time;
-  assert(clock_gettime(CLOCK_MONOTONIC, &time) == 0);
+  const int ret = clock_gettime(CLOCK_MONOTONIC, &time);
+  assert(ret == 0);
+  (void)ret;
   return ((uint64_t)time.tv_sec * 1000000000LLU + time.tv_nsec) -
     adl.startTime * 1000000LLU;
 }
@@ -50,7 +75,7 @@ void adlWaitUntilMS(uint64_t clockMS)
   const struct timespec time =
   {
     .tv_sec  = clockMS / 1000LLU,
-    .tv_nsec = (clockMS % 1000LLU) * 1000LLU
+    .tv_nsec = (clockMS % 1000LLU) * 1000000LLU
   };
   while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) != 0) {}
 }
@@ -65,3 +90,95 @@ void adlWaitUntilNS(uint64_t clockNS)
   };
   while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) != 0) {}
 }
+
+static inline unsigned int waitBucket(uint64_t ns)
+{
+  const unsigned int b = ns ? 64 - __builtin_clzll(ns) : 0;
+  return b < ADL_WAIT_BUCKETS ? b : ADL_WAIT_BUCKETS - 1;
+}
+
+void adlWaitUntilNSPrecise(uint64_t clockNS)
+{
+  uint64_t margin = atomic_load_explicit(&wait.margin, memory_order_relaxed);
+  uint64_t now    = adlGetClockNS();
+
+  if (clockNS > now + margin)
+  {
+    const uint64_t target = clockNS - margin;
+    adlWaitUntilNS(target);
+    now = adlGetClockNS();
+
+    /* grow quickly when the sleep overshoots the margin and shrink slowly
+     * towards the typical overshoot otherwise */
+    const uint64_t over = now > target ? now - target : 0;
+    atomic_fetch_add_explicit(&wait.oversleep[waitBucket(over)], 1,
+        memory_order_relaxed);
+
+    if (over >= margin)
+      margin = over + over / 4;
+    else
+      margin -= (margin - over) / 64;
+
+    const uint64_t budget = atomic_load_explicit(&wait.budget,
+        memory_order_relaxed);
+    if (margin > budget)
+      margin = budget;
+    if (margin < WAIT_MIN_MARGIN)
+      margin = WAIT_MIN_MARGIN;
+    atomic_store_explicit(&wait.margin, margin, memory_order_relaxed);
+  }
+  else if (margin > WAIT_MIN_MARGIN)
+  {
+    /* waits shorter than the margin never sleep, so without this a single
+     * large overshoot would keep every following short wait spinning */
+    margin -= (margin - WAIT_MIN_MARGIN) / 64;
+    atomic_store_explicit(&wait.margin, margin, memory_order_relaxed);
+  }
+
+  const uint64_t spinStart = now;
+  while(now < clockNS)
+  {
+    adlCPURelax();
+    now = adlGetClockNS();
+  }
+
+  atomic_fetch_add_explicit(&wait.waits , 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&wait.spinNS, now - spinStart,
+      memory_order_relaxed);
+  atomic_fetch_add_explicit(&wait.late[waitBucket(now - clockNS)], 1,
+      memory_order_relaxed);
+}
+
+void adlSetWaitSpinBudget(uint64_t maxNS)
+{
+  atomic_store(&wait.budget, maxNS);
+}
+
+void adlGetWaitStats(ADLWaitStats * stats)
+{
+  stats->waits    = atomic_load(&wait.waits );
+  stats->spinNS   = atomic_load(&wait.spinNS);
+  stats->marginNS = atomic_load(&wait.margin);
+  for(int i = 0; i < ADL_WAIT_BUCKETS; ++i)
+  {
+    stats->late     [i] = atomic_load(&wait.late     [i]);
+    stats->oversleep[i] = atomic_load(&wait.oversleep[i]);
+  }
+}
+
+void adlResetWaitStats(void)
+{
+  atomic_store(&wait.waits , 0);
+  atomic_store(&wait.spinNS, 0);
+  for(int i = 0; i < ADL_WAIT_BUCKETS; ++i)
+  {
+    atomic_store(&wait.late     [i], 0);
+    atomic_store(&wait.oversleep[i], 0);
+  }
+}
+
+unsigned int adlGetCPUCount(void)
+{
+  const long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (unsigned int)count : 1;
+}
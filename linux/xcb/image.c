@@ -1,10 +1,13 @@
 #include "xcb.h"
 #include "image.h"
+#include "src/convert.h"
 
 #include <xcb/dri3.h>
 #include <xcb/present.h>
+#include <xcb/xfixes.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 ADL_STATUS xcbImageGetSupported(const ADLImageBackend ** result)
 {
@@ -18,37 +21,312 @@ ADL_STATUS xcbImageGetSupported(const ADLImageBackend ** result)
   return ADL_OK;
 }
 
+static bool growBuffer(void ** buffer, size_t * size, size_t needed)
+{
+  if (*size >= needed)
+    return true;
+
+  void * tmp = realloc(*buffer, needed);
+  if (!tmp)
+  {
+    ADL_ERROR(ADL_ERR_NO_MEM, "failed to allocate %zu bytes", needed);
+    return false;
+  }
+
+  *buffer = tmp;
+  *size   = needed;
+  return true;
+}
+
+static void putImage(ImageData * idata, const uint8_t * data,
+    unsigned int pitch, const ADLRect * rect)
+{
+  ADL_TRACE_SCOPE("xcbPutImage");
+
+  /* the server expects each row to be padded to 32 bits */
+  const unsigned int bpp         = idata->def.depth / 8;
+  const unsigned int len         = rect->w * bpp;
+  const unsigned int packedPitch = (len + 3) & ~3U;
+
+  data += rect->y * pitch + rect->x * bpp;
+
+  /* sub-rectangles and padded buffers need packing first */
+  if (pitch != packedPitch)
+  {
+    if (!growBuffer(&idata->scratch, &idata->scratchSize,
+          (size_t)packedPitch * rect->h))
+      return;
+
+    for(int y = 0; y < rect->h; ++y)
+      memcpy((uint8_t *)idata->scratch + y * packedPitch, data + y * pitch,
+          len);
+
+    data  = idata->scratch;
+    pitch = packedPitch;
+  }
+
+  /* large images may exceed the maximum request length, split them up */
+  const uint32_t maxLength = xcb_get_maximum_request_length(this.xcb) * 4 -
+    sizeof(xcb_put_image_request_t);
+
+  unsigned int rows = maxLength / pitch;
+  if (rows == 0)
+    rows = 1;
+
+  for(unsigned int y = 0; y < rect->h; y += rows)
+  {
+    if (rows > rect->h - y)
+      rows = rect->h - y;
+
+    xcb_put_image(
+      this.xcb,
+      XCB_IMAGE_FORMAT_Z_PIXMAP,
+      idata->pixmap,
+      idata->gc,
+      rect->w,
+      rows,
+      rect->x, rect->y + y,
+      0,
+      idata->def.bpp,
+      rows * pitch,
+      data + y * pitch
+    );
+  }
+}
+
+/* upload the rectangles of a buffer image, or all of it if `rects` is NULL */
+static void uploadBuffer(ImageData * idata, const void * buffer,
+    const ADLRect * rects, unsigned int count)
+{
+  const ADLImageDef * def   = &idata->def;
+  const uint8_t     * data  = buffer;
+  unsigned int        pitch = def->pitch;
+
+  if (idata->upload)
+  {
+    adlConvertToBGRX(def, buffer, idata->upload, idata->uploadPitch);
+    data  = idata->upload;
+    pitch = idata->uploadPitch;
+  }
+
+  if (!rects)
+  {
+    const ADLRect rect = { .w = def->w, .h = def->h };
+    putImage(idata, data, pitch, &rect);
+    return;
+  }
+
+  for(unsigned int i = 0; i < count; ++i)
+    putImage(idata, data, pitch, &rects[i]);
+}
+
+/* present the rectangles of the image, or all of it if `rects` is NULL, with
+ * the image origin at x,y in the window. Buffer images are uploaded from
+ * `buffer` or their own storage if NULL. If `clip` is set only the rectangles
+ * are considered valid */
+static ADL_STATUS present(ImageData * idata, const void * buffer, int x, int y,
+    const ADLRect * rects, unsigned int count, bool clip)
+{
+  ADL_TRACE_SCOPE("xcbPresent");
+  WindowData * wdata = ADL_GET_WINDOW_DATA(idata->window);
+
+  if (!idata->presentPixmap && idata->def.bpp != wdata->bpp)
+    return ADL_ERR_UNSUPPORTED_FORMAT;
+
+  /* buffer images don't share storage with the server, upload them again */
+  if (idata->def.backend == ADL_IMAGE_BACKEND_BUFFER)
+    uploadBuffer(idata, buffer ? buffer : idata->def.u.buffer, rects, count);
+
+  const ADLRect full = { .w = idata->def.w, .h = idata->def.h };
+  const bool    partial = rects != NULL;
+  if (!rects)
+  {
+    rects = &full;
+    count = 1;
+  }
+
+  xcb_pixmap_t pixmap = idata->pixmap;
+  if (idata->presentPixmap)
+  {
+    for(unsigned int i = 0; i < count; ++i)
+      xcb_render_composite(
+        this.xcb,
+        XCB_RENDER_PICT_OP_SRC,
+        idata->srcPicture,
+        XCB_NONE,
+        idata->dstPicture,
+        rects[i].x, rects[i].y,
+        0, 0,
+        rects[i].x, rects[i].y,
+        rects[i].w, rects[i].h
+      );
+    pixmap = idata->presentPixmap;
+  }
+
+  /* without the present extension fall back to a plain copy */
+  if (!this.havePresent)
+  {
+    /* the source is at the window's depth here, which may not be the
+     * depth of the image's own pixmap and gc */
+    if (!idata->copyGC)
+    {
+      idata->copyGC = xcb_generate_id(this.xcb);
+      xcb_create_gc(this.xcb, idata->copyGC, wdata->window, 0, NULL);
+    }
+
+    for(unsigned int i = 0; i < count; ++i)
+      xcb_copy_area(
+        this.xcb,
+        pixmap,
+        wdata->window,
+        idata->copyGC,
+        rects[i].x, rects[i].y,
+        x + rects[i].x, y + rects[i].y,
+        rects[i].w, rects[i].h
+      );
+
+    return ADL_OK;
+  }
+
+  xcb_xfixes_region_t update = XCB_NONE;
+  if (partial)
+  {
+    if (!growBuffer((void **)&idata->xrects, &idata->xrectsSize,
+          sizeof(xcb_rectangle_t) * count))
+      return ADL_ERR_NO_MEM;
+
+    for(unsigned int i = 0; i < count; ++i)
+      idata->xrects[i] = (xcb_rectangle_t)
+      {
+        .x      = rects[i].x,
+        .y      = rects[i].y,
+        .width  = rects[i].w,
+        .height = rects[i].h
+      };
+
+    if (!idata->region)
+    {
+      idata->region = xcb_generate_id(this.xcb);
+      xcb_xfixes_create_region(this.xcb, idata->region, count, idata->xrects);
+    }
+    else
+      xcb_xfixes_set_region(this.xcb, idata->region, count, idata->xrects);
+
+    update = idata->region;
+  }
+
+  xcb_present_pixmap(
+    this.xcb,
+    wdata->window,
+    pixmap,
+    idata->serial++,
+    clip ? update : XCB_NONE, // valid
+    update,                   // dirty
+    x,
+    y,
+    0,
+    0,
+    0,
+    XCB_PRESENT_OPTION_COPY,
+    0, 0, 0, 0,
+    NULL
+  );
+
+  return ADL_OK;
+}
+
+static RenderFormat getRenderFormat(const ADLImageFormat format,
+    const unsigned int bpp)
+{
+  switch(format)
+  {
+    case ADL_IMAGE_FORMAT_RGBA:
+      switch(bpp)
+      {
+        case 24: return RF_RGB;
+        case 32: return RF_RGBA;
+      }
+      break;
+
+    case ADL_IMAGE_FORMAT_BGRA:
+      switch(bpp)
+      {
+        case 24: return RF_BGR;
+        case 32: return RF_BGRA;
+      }
+      break;
+
+    case ADL_IMAGE_FORMAT_RGB565     : return RF_RGB565;
+    case ADL_IMAGE_FORMAT_XRGB2101010: return RF_XRGB2101010;
+
+    default:
+      break;
+  }
+
+  return RF_INVALID;
+}
+
 ADL_STATUS xcbImageCreate(ADLWindow * window, const ADLImageDef def,
     ADLImage * result)
 {
   WindowData * wdata = ADL_GET_WINDOW_DATA(window);
   ImageData  * idata = ADL_GET_IMAGE_DATA (result);
+  ADL_STATUS   status;
 
   idata->window = window;
   idata->def    = def;
 
+  /* packed formats have a fixed depth and size */
   switch(def.format)
   {
-    case ADL_IMAGE_FORMAT_RGBA:
-      switch(def.bpp)
-      {
-        case 24: idata->format = &this.formatRGB ; break;
-        case 32: idata->format = &this.formatRGBA; break;
-      }
+    case ADL_IMAGE_FORMAT_RGB565:
+      idata->def.bpp   = 16;
+      idata->def.depth = 16;
       break;
 
-    case ADL_IMAGE_FORMAT_BGRA:
-      switch(def.bpp)
-      {
-        case 24: idata->format = &this.formatBGR;  break;
-        case 32: idata->format = &this.formatBGRA; break;
-      }
+    case ADL_IMAGE_FORMAT_XRGB2101010:
+      idata->def.bpp   = 30;
+      idata->def.depth = 32;
+      break;
+
+    default:
       break;
   }
 
-  if (!idata->format || idata->format->id == 0)
+  RenderFormat rf = getRenderFormat(def.format, idata->def.bpp);
+
+  /* formats the server can't take directly are converted on upload */
+  if ((rf == RF_INVALID || this.formats[rf].id == 0) &&
+      adlConvertIsSupported(def.format))
+  {
+    if (def.backend != ADL_IMAGE_BACKEND_BUFFER)
+      return ADL_ERR_UNSUPPORTED_FORMAT;
+
+    if (adlConvertIsYUV(def.format) &&
+        (status = adlConvertCheckYUV(&def)) != ADL_OK)
+      return status;
+
+    idata->def.bpp     = wdata->bpp == 32 ? 32 : 24;
+    idata->def.depth   = 32;
+    idata->uploadPitch = def.w * 4;
+    rf                 = idata->def.bpp == 32 ? RF_BGRA : RF_BGR;
+  }
+
+  if (rf == RF_INVALID || this.formats[rf].id == 0)
     return ADL_ERR_UNSUPPORTED;
 
+  idata->format = &this.formats[rf];
+
+  if (idata->uploadPitch)
+  {
+    idata->upload = malloc(idata->uploadPitch * def.h);
+    if (!idata->upload)
+    {
+      ADL_ERROR(ADL_ERR_NO_MEM, "failed to allocate the upload buffer");
+      return ADL_ERR_NO_MEM;
+    }
+  }
+
   switch(def.backend)
   {
     case ADL_IMAGE_BACKEND_DMABUF:
@@ -64,13 +342,13 @@ ADL_STATUS xcbImageCreate(ADLWindow * window, const ADLImageDef def,
           def.w,
           def.h,
           def.pitch,
-          def.bpp,
-          def.depth,
+          idata->def.bpp,
+          idata->def.depth,
           def.u.dmabuf.fd
         );
 
       xcb_generic_error_t *error;
-      if ((error = xcb_request_check(this.xcb, c)))
+      if ((error = ADL_AUDIT_WAIT(xcb_request_check, this.xcb, c)))
       {
         ADL_ERROR(ADL_ERR_PLATFORM, "dri3_pixmap_from_buffer failure: code %d",
           error->error_code);
@@ -85,72 +363,102 @@ ADL_STATUS xcbImageCreate(ADLWindow * window, const ADLImageDef def,
       idata->pixmap = xcb_generate_id(this.xcb);
       xcb_create_pixmap(
         this.xcb,
-        def.depth,
+        idata->def.bpp,
         idata->pixmap,
         wdata->window,
         def.w,
         def.h
       );
 
-      xcb_gcontext_t gc = xcb_generate_id(this.xcb);
-      xcb_create_gc(this.xcb, gc, idata->pixmap, 0, 0);
-      xcb_put_image(
-        this.xcb,
-        XCB_IMAGE_FORMAT_Z_PIXMAP,
-        idata->pixmap,
-        gc,
-        def.w,
-        def.h,
-        0, 0,
-        0,
-        def.depth,
-        def.h * def.pitch,
-        def.u.buffer
-      );
-      xcb_free_gc(this.xcb, gc);
+      idata->gc = xcb_generate_id(this.xcb);
+      xcb_create_gc(this.xcb, idata->gc, idata->pixmap, 0, 0);
+      uploadBuffer(idata, def.u.buffer, NULL, 0);
       break;
     }
 
     default:
-      return ADL_ERR_UNSUPPORTED_BACKEND;
+      status = ADL_ERR_UNSUPPORTED_BACKEND;
+      goto err_free;
+  }
+
+  /* if the depth doesn't match the window, have the server convert it into a
+   * pixmap that can be presented */
+  if (idata->def.bpp != wdata->bpp)
+  {
+    if (this.visualFormat.id == 0)
+    {
+      status = ADL_ERR_UNSUPPORTED_FORMAT;
+      goto err_free_pixmap;
+    }
+
+    idata->presentPixmap = xcb_generate_id(this.xcb);
+    xcb_create_pixmap(this.xcb, wdata->bpp, idata->presentPixmap,
+        wdata->window, def.w, def.h);
+
+    idata->srcPicture = xcb_generate_id(this.xcb);
+    xcb_render_create_picture(this.xcb, idata->srcPicture, idata->pixmap,
+        idata->format->id, 0, NULL);
+
+    idata->dstPicture = xcb_generate_id(this.xcb);
+    xcb_render_create_picture(this.xcb, idata->dstPicture,
+        idata->presentPixmap, this.visualFormat.id, 0, NULL);
   }
 
   ADL_SET_IMAGE_ID(result, idata->pixmap);
   return ADL_OK;
+
+err_free_pixmap:
+  if (idata->gc)
+    xcb_free_gc(this.xcb, idata->gc);
+  xcb_free_pixmap(this.xcb, idata->pixmap);
+err_free:
+  free(idata->upload);
+  idata->upload = NULL;
+  return status;
 }
 
 ADL_STATUS xcbImageDestroy(ADLImage * image)
 {
   ImageData * idata = ADL_GET_IMAGE_DATA(image);
 
+  if (idata->presentPixmap)
+  {
+    xcb_render_free_picture(this.xcb, idata->dstPicture);
+    xcb_render_free_picture(this.xcb, idata->srcPicture);
+    xcb_free_pixmap(this.xcb, idata->presentPixmap);
+  }
+
+  if (idata->region)
+    xcb_xfixes_destroy_region(this.xcb, idata->region);
+
+  if (idata->gc)
+    xcb_free_gc(this.xcb, idata->gc);
+
+  if (idata->copyGC)
+    xcb_free_gc(this.xcb, idata->copyGC);
+
   xcb_free_pixmap(this.xcb, idata->pixmap);
+  free(idata->upload);
+  free(idata->scratch);
+  free(idata->xrects);
   return ADL_OK;
 }
 
 ADL_STATUS xcbImageUpdate(ADLImage * image)
 {
-  ImageData  * idata = ADL_GET_IMAGE_DATA(image);
-  WindowData * wdata = ADL_GET_WINDOW_DATA(idata->window);
-
-  if (idata->def.bpp != wdata->bpp)
-    return ADL_ERR_UNSUPPORTED_FORMAT;
+  return present(ADL_GET_IMAGE_DATA(image), NULL, 0, 0, NULL, 0, false);
+}
 
-  xcb_present_pixmap(
-    this.xcb,
-    wdata->window,
-    idata->pixmap,
-    idata->serial++,
-    0, // valid
-    0, // dirty
-    0, // x
-    0, // y
-    0,
-    0,
-    0,
-    XCB_PRESENT_OPTION_COPY,
-    0, 0, 0, 0,
-    NULL
-  );
+ADL_STATUS xcbImageUpdateRects(ADLImage * image, const void * buffer,
+    const ADLRect * rects, unsigned int count)
+{
+  return present(ADL_GET_IMAGE_DATA(image), buffer, 0, 0, rects, count, false);
+}
 
-  return ADL_OK;
+ADL_STATUS xcbImagePresentAt(ADLImage * image, int x, int y,
+    const ADLRect * src)
+{
+  /* offset the image so that the source rectangle lands at x,y */
+  return present(ADL_GET_IMAGE_DATA(image), NULL, x - src->x, y - src->y, src,
+      1, true);
 }
@@ -29,6 +29,7 @@
 #include "adl/image.h"
 
 #include <xcb/render.h>
+#include <xcb/xfixes.h>
 
 typedef struct
 {
@@ -37,8 +38,26 @@ typedef struct
 
   xcb_render_pictforminfo_t * format;
 
-  xcb_pixmap_t pixmap;
-  unsigned int serial;
+  xcb_pixmap_t   pixmap;
+  xcb_gcontext_t gc;
+  // created on the window for the copy fallback, gc is at the image's depth
+  xcb_gcontext_t copyGC;
+  unsigned int   serial;
+
+  // server side conversion when the image depth doesn't match the window
+  xcb_pixmap_t         presentPixmap;
+  xcb_render_picture_t srcPicture, dstPicture;
+
+  // conversion buffer for formats the server can't take directly
+  void *       upload;
+  unsigned int uploadPitch;
+
+  // buffers for packing sub-rectangles and the present update region
+  void *              scratch;
+  size_t              scratchSize;
+  xcb_rectangle_t *   xrects;
+  size_t              xrectsSize;
+  xcb_xfixes_region_t region;
 }
 ImageData;
 
@@ -47,5 +66,9 @@ ADL_STATUS xcbImageCreate(ADLWindow * window, const ADLImageDef def,
     ADLImage * result);
 ADL_STATUS xcbImageDestroy(ADLImage * image);
 ADL_STATUS xcbImageUpdate(ADLImage * image);
+ADL_STATUS xcbImageUpdateRects(ADLImage * image, const void * buffer,
+    const ADLRect * rects, unsigned int count);
+ADL_STATUS xcbImagePresentAt(ADLImage * image, int x, int y,
+    const ADLRect * src);
 
 #endif
@@ -24,11 +24,14 @@
 
 #include "src/adl.h"
 #include "src/window.h"
+#include "src/timer.h"
 #include "interface/adl.h"
 
 #include "atoms.h"
 #include "image.h"
 
+#include <xcb/present.h>
+
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
@@ -173,7 +176,8 @@ static ADL_STATUS getParentWindowOffset(xcb_window_t window, WindowData * data)
   if (!data->parent)
   {
     xcb_query_tree_cookie_t qc = xcb_query_tree(this.xcb, window);
-    xcb_query_tree_reply_t *qr = xcb_query_tree_reply(this.xcb, qc, &error);
+    xcb_query_tree_reply_t *qr =
+      ADL_AUDIT_WAIT(xcb_query_tree_reply, this.xcb, qc, &error);
 
     if (error)
     {
@@ -193,7 +197,7 @@ static ADL_STATUS getParentWindowOffset(xcb_window_t window, WindowData * data)
         this.screen->root, 0, 0);
 
   xcb_translate_coordinates_reply_t *tr =
-    xcb_translate_coordinates_reply(this.xcb, tc, &error);
+    ADL_AUDIT_WAIT(xcb_translate_coordinates_reply, this.xcb, tc, &error);
 
   if (error)
   {
@@ -250,6 +254,15 @@ static ADL_STATUS xcbInitialize()
   ADL_STATUS status = ADL_OK;
   int err;
 
+  /* the connection is shared by every thread that calls into ADL, xcb itself
+   * is thread-safe but Xlib is not unless told so before opening the display */
+  if (adl.threadSafe && !XInitThreads())
+  {
+    status = ADL_ERR_PLATFORM;
+    ADL_ERROR(status, "XInitThreads failed");
+    goto err_out;
+  }
+
   this.display = XOpenDisplay(NULL);
   if (!this.display)
   {
@@ -278,7 +291,8 @@ static ADL_STATUS xcbInitialize()
     xcb_generic_error_t * error;
     xcb_intern_atom_cookie_t c = xcb_intern_atom(this.xcb, 1,
         strlen(internAtom[i].name), internAtom[i].name);
-    xcb_intern_atom_reply_t * r = xcb_intern_atom_reply(this.xcb, c, &error);
+    xcb_intern_atom_reply_t * r =
+      ADL_AUDIT_WAIT(xcb_intern_atom_reply, this.xcb, c, &error);
 
     if (error)
     {
@@ -300,7 +314,7 @@ static ADL_STATUS xcbInitialize()
           XCB_XKB_MAJOR_VERSION, XCB_XKB_MINOR_VERSION);
 
     xcb_xkb_use_extension_reply_t * r =
-      xcb_xkb_use_extension_reply(this.xcb, c, NULL);
+      ADL_AUDIT_WAIT(xcb_xkb_use_extension_reply, this.xcb, c, NULL);
 
     if (!r)
     {
@@ -312,6 +326,50 @@ static ADL_STATUS xcbInitialize()
     free(r);
   }
 
+  /* present update regions are xfixes regions */
+  {
+    xcb_xfixes_query_version_cookie_t c =
+      xcb_xfixes_query_version(this.xcb,
+          XCB_XFIXES_MAJOR_VERSION, XCB_XFIXES_MINOR_VERSION);
+
+    xcb_xfixes_query_version_reply_t * r =
+      ADL_AUDIT_WAIT(xcb_xfixes_query_version_reply, this.xcb, c, NULL);
+
+    if (!r)
+    {
+      ADL_INFO(ADL_ERR_PLATFORM, "xcb_xfixes_query_version failed");
+      status = ADL_ERR_PLATFORM;
+      goto err_disconnect;
+    }
+
+    free(r);
+  }
+
+  /* without present, images are copied to the window instead */
+  {
+    const xcb_query_extension_reply_t * ext =
+      xcb_get_extension_data(this.xcb, &xcb_present_id);
+
+    if (ext && ext->present)
+    {
+      xcb_present_query_version_cookie_t c =
+        xcb_present_query_version(this.xcb,
+            XCB_PRESENT_MAJOR_VERSION, XCB_PRESENT_MINOR_VERSION);
+
+      xcb_present_query_version_reply_t * r =
+        ADL_AUDIT_WAIT(xcb_present_query_version_reply, this.xcb, c, NULL);
+
+      if (r)
+      {
+        this.havePresent = true;
+        free(r);
+      }
+    }
+
+    if (!this.havePresent)
+      ADL_INFO(ADL_OK, "Present is unavailable, using CopyArea instead");
+  }
+
   /* prevent auto-repeat of key up events */
   xcb_xkb_per_client_flags(this.xcb, XCB_XKB_ID_USE_CORE_KBD,
     XCB_XKB_PER_CLIENT_FLAG_DETECTABLE_AUTO_REPEAT,
@@ -325,7 +383,7 @@ static ADL_STATUS xcbInitialize()
           XCB_XKB_NAME_DETAIL_KEY_NAMES);
 
     xcb_xkb_get_names_reply_t * r =
-      xcb_xkb_get_names_reply(this.xcb, c, NULL);
+      ADL_AUDIT_WAIT(xcb_xkb_get_names_reply, this.xcb, c, NULL);
 
     if (!r)
     {
@@ -382,7 +440,7 @@ static ADL_STATUS xcbInitialize()
           1,
           1);
 
-    if ((error = xcb_request_check(this.xcb, c)))
+    if ((error = ADL_AUDIT_WAIT(xcb_request_check, this.xcb, c)))
     {
       ADL_INFO(ADL_ERR_PLATFORM, "failed to create the blank pixmap");
       status = ADL_ERR_PLATFORM;
@@ -397,7 +455,7 @@ static ADL_STATUS xcbInitialize()
           this.blankPixmap,
           0, 0, 0, 0, 0, 0, 0, 0);
 
-    if ((error = xcb_request_check(this.xcb, c)))
+    if ((error = ADL_AUDIT_WAIT(xcb_request_check, this.xcb, c)))
     {
       ADL_INFO(ADL_ERR_PLATFORM, "failed to create the blank pointer");
       status = ADL_ERR_PLATFORM;
@@ -418,92 +476,79 @@ static ADL_STATUS xcbInitialize()
 
   /* lookup the render formats for later use */
   {
+    struct FormatKey
+    {
+      uint8_t  depth;
+      uint16_t redShift  , redMask;
+      uint16_t greenShift, greenMask;
+      uint16_t blueShift , blueMask;
+      uint16_t alphaShift, alphaMask;
+    };
+
+    #define RENDER_FORMAT(name, ...) [RF_ ##name] = { __VA_ARGS__ },
+    static const struct FormatKey keys[] = { RENDER_FORMATS };
+    #undef RENDER_FORMAT
+
+    #define MATCH_CHANNEL(x) \
+      (f->direct.x ##_mask == k->x ##Mask && \
+       (k->x ##Mask == 0 || f->direct.x ##_shift == k->x ##Shift))
+
     xcb_render_query_pict_formats_cookie_t c =
       xcb_render_query_pict_formats(this.xcb);
 
     xcb_render_query_pict_formats_reply_t * r =
-      xcb_render_query_pict_formats_reply(this.xcb, c, 0);
+      ADL_AUDIT_WAIT(xcb_render_query_pict_formats_reply, this.xcb, c, 0);
 
-    xcb_render_pictforminfo_t * format =
+    xcb_render_pictforminfo_t * formats =
       xcb_render_query_pict_formats_formats(r);
 
-    for(int i = 0; i < r->num_formats; ++i, ++format)
+    for(int i = 0; i < r->num_formats; ++i)
     {
-      if (format->type != XCB_RENDER_PICT_TYPE_DIRECT)
+      const xcb_render_pictforminfo_t * f = &formats[i];
+      if (f->type != XCB_RENDER_PICT_TYPE_DIRECT)
         continue;
 
-      // must contain the red channel
-      if (format->direct.red_mask != 0xff)
-        continue;
-
-      switch(format->direct.red_shift)
+      for(int j = 0; j < RF_COUNT; ++j)
       {
-        //RGBA, ARGB
-#ifdef ENDIAN_LITTLE
-        case 0:
-        case 8:
-#else
-        case 16:
-        case 24:
-#endif
-        {
-          if (format->depth == 24)
-          {
-            this.formatRGB = *format;
-            break;
-          }
+        const struct FormatKey * k = &keys[j];
+        if (f->depth == k->depth &&
+            MATCH_CHANNEL(red  ) && MATCH_CHANNEL(green) &&
+            MATCH_CHANNEL(blue ) && MATCH_CHANNEL(alpha))
+          this.formats[j] = *f;
+      }
+    }
 
-          // if has the alpha channel
-          if (format->depth == 32 && format->direct.alpha_mask == 0xff)
-          {
-            switch(format->direct.alpha_shift)
-            {
-#ifdef ENDIAN_LITTLE
-              case 24: this.formatRGBA = *format; break;
-              case 0 : this.formatARGB = *format; break;
-#else
-              case 0 : this.formatRGBA = *format; break;
-              case 24: this.formatARGB = *format; break;
-#endif
-            }
-          }
-        }
-        break;
+    #undef MATCH_CHANNEL
 
-        //BGRA, ABGR
-#ifdef ENDIAN_LITTLE
-        case 16:
-        case 24:
-#else
-        case 0:
-        case 8:
-#endif
-        {
-          if (format->depth == 24)
+    /* find the format of the root visual that our windows inherit */
+    xcb_render_pictvisual_t * visual = NULL;
+    xcb_render_pictscreen_iterator_t si =
+      xcb_render_query_pict_formats_screens_iterator(r);
+    for(; si.rem && !visual; xcb_render_pictscreen_next(&si))
+    {
+      xcb_render_pictdepth_iterator_t di =
+        xcb_render_pictscreen_depths_iterator(si.data);
+      for(; di.rem && !visual; xcb_render_pictdepth_next(&di))
+      {
+        xcb_render_pictvisual_iterator_t vi =
+          xcb_render_pictdepth_visuals_iterator(di.data);
+        for(; vi.rem; xcb_render_pictvisual_next(&vi))
+          if (vi.data->visual == this.screen->root_visual)
           {
-            this.formatBGR = *format;
+            visual = vi.data;
             break;
           }
-
-          // if has the alpha channel
-          if (format->depth == 32 && format->direct.alpha_mask == 0xff)
-          {
-            switch(format->direct.alpha_shift)
-            {
-#ifdef ENDIAN_LITTLE
-              case 24: this.formatBGRA = *format; break;
-              case 0 : this.formatABGR = *format; break;
-#else
-              case 0 : this.formatBGRA = *format; break;
-              case 24: this.formatABGR = *format; break;
-#endif
-            }
-          }
-        }
-        break;
       }
     }
 
+    if (visual)
+      for(int i = 0; i < r->num_formats; ++i)
+        if (formats[i].id == visual->format)
+        {
+          this.visualFormat = formats[i];
+          break;
+        }
+
     free(r);
   }
 
@@ -548,7 +593,7 @@ static ADL_STATUS xcbWindowCreate(const ADLWindowDef def, ADLWindow * result)
     XCB_EVENT_MASK_KEY_PRESS        | XCB_EVENT_MASK_KEY_RELEASE       |
     XCB_EVENT_MASK_BUTTON_PRESS     | XCB_EVENT_MASK_BUTTON_RELEASE    |
     XCB_EVENT_MASK_POINTER_MOTION   | XCB_EVENT_MASK_ENTER_WINDOW      |
-    XCB_EVENT_MASK_LEAVE_WINDOW     | XCB_EVENT_MASK_EXPOSURE;
+    XCB_EVENT_MASK_LEAVE_WINDOW     | XCB_EVENT_MASK_FOCUS_CHANGE;
 
   uint32_t values[3] =
   {
@@ -584,7 +629,7 @@ static ADL_STATUS xcbWindowCreate(const ADLWindowDef def, ADLWindow * result)
     );
 
   xcb_generic_error_t *error;
-  if ((error = xcb_request_check(this.xcb, c)))
+  if ((error = ADL_AUDIT_WAIT(xcb_request_check, this.xcb, c)))
   {
     ADL_ERROR(ADL_ERR_PLATFORM, "xcb_create_window failed: code=%d, res=%d",
       error->error_code, error->resource_id);
@@ -605,7 +650,8 @@ static ADL_STATUS xcbWindowCreate(const ADLWindowDef def, ADLWindow * result)
   /* get the window bit depth */
   {
     xcb_get_geometry_cookie_t  c = xcb_get_geometry(this.xcb, window);
-    xcb_get_geometry_reply_t * r = xcb_get_geometry_reply(this.xcb, c, NULL);
+    xcb_get_geometry_reply_t * r =
+      ADL_AUDIT_WAIT(xcb_get_geometry_reply, this.xcb, c, NULL);
     if (!r)
     {
       xcb_destroy_window(this.xcb, window);
@@ -714,7 +760,7 @@ static ADL_STATUS xcbWindowSetGrab(ADLWindow * window, bool enable)
         XCB_TIME_CURRENT_TIME);
 
     xcb_grab_pointer_reply_t *reply;
-    if ((reply = xcb_grab_pointer_reply(this.xcb, c, NULL)))
+    if ((reply = ADL_AUDIT_WAIT(xcb_grab_pointer_reply, this.xcb, c, NULL)))
     {
       if (reply->status != XCB_GRAB_STATUS_SUCCESS)
       {
@@ -731,7 +777,7 @@ static ADL_STATUS xcbWindowSetGrab(ADLWindow * window, bool enable)
       xcb_ungrab_pointer_checked(this.xcb, XCB_TIME_CURRENT_TIME);
 
     xcb_generic_error_t *error;
-    if ((error = xcb_request_check(this.xcb, c)))
+    if ((error = ADL_AUDIT_WAIT(xcb_request_check, this.xcb, c)))
     {
       ADL_ERROR(ADL_ERR_PLATFORM, "failed to un-grab the pointer");
       free(error);
@@ -790,23 +836,38 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
 {
   xcb_generic_event_t * xevent;
 
-  if (timeout < 0)
+  /* also wake when an event loop timer expires */
+  const int timerFd = timerEventFd();
+
+again:
+  if (timeout < 0 && timerFd < 0)
     xevent = xcb_wait_for_event(this.xcb);
   else
   {
     xevent = xcb_poll_for_queued_event(this.xcb);
-    if (!xevent && timeout > 0)
+    if (!xevent && timeout == 0)
+      xevent = xcb_poll_for_event(this.xcb);
+    else if (!xevent)
     {
+      /* unlike xcb_wait_for_event select does not send pending requests,
+       * without this a map or present can sit in the output buffer and the
+       * events it would cause never arrive */
+      xcb_flush(this.xcb);
+
       fd_set fds;
       FD_ZERO(&fds);
       FD_SET (this.fd, &fds);
+      if (timerFd >= 0)
+        FD_SET(timerFd, &fds);
+
       struct timeval tv =
       {
         .tv_sec  = timeout / 1000,
         .tv_usec = (timeout % 1000) * 1000
       };
 
-      if (select(this.fd + 1, &fds, NULL, NULL, &tv) == 0)
+      const int nfds = (timerFd > this.fd ? timerFd : this.fd) + 1;
+      if (select(nfds, &fds, NULL, NULL, timeout < 0 ? NULL : &tv) <= 0)
         return ADL_OK;
 
       xevent = xcb_poll_for_event(this.xcb);
@@ -831,14 +892,14 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
           break;
 
         event->type   = ADL_EVENT_CLOSE;
-        event->window = windowFindById(e->window);
+        event->window = windowFindLocked(e->window);
         break;
       }
 
       if (e->type == getAtom(IA_ADL_EVENT))
       {
         event->type   = ADL_EVENT_QUIT;
-        event->window = windowFindById(e->window);
+        event->window = windowFindLocked(e->window);
         break;
       }
 
@@ -849,7 +910,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
     {
       xcb_expose_event_t * e = (xcb_expose_event_t *)xevent;
       event->type   = ADL_EVENT_PAINT;
-      event->window = windowFindById(e->window);
+      event->window = windowFindLocked(e->window);
       event->u.paint.x    = e->x;
       event->u.paint.y    = e->y;
       event->u.paint.w    = e->width;
@@ -862,7 +923,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
     {
       xcb_map_notify_event_t * e = (xcb_map_notify_event_t *)xevent;
       event->type   = ADL_EVENT_SHOW;
-      event->window = windowFindById(e->event);
+      event->window = windowFindLocked(e->event);
       break;
     }
 
@@ -870,7 +931,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
     {
       xcb_map_notify_event_t * e = (xcb_map_notify_event_t *)xevent;
       event->type   = ADL_EVENT_HIDE;
-      event->window = windowFindById(e->event);
+      event->window = windowFindLocked(e->event);
       break;
     }
 
@@ -884,7 +945,25 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
       else
         event->type = ADL_EVENT_SHOW;
 
-      event->window = windowFindById(e->window);
+      event->window = windowFindLocked(e->window);
+      break;
+    }
+
+    case XCB_FOCUS_IN:
+    case XCB_FOCUS_OUT:
+    {
+      xcb_focus_in_event_t * e = (xcb_focus_in_event_t *)xevent;
+
+      /* ignore focus moving within the window and keyboard grabs */
+      if (e->detail == XCB_NOTIFY_DETAIL_INFERIOR ||
+          e->detail == XCB_NOTIFY_DETAIL_POINTER  ||
+          e->mode   == XCB_NOTIFY_MODE_GRAB       ||
+          e->mode   == XCB_NOTIFY_MODE_UNGRAB)
+        break;
+
+      event->type   = (xevent->response_type & ~0x80) == XCB_FOCUS_IN ?
+        ADL_EVENT_FOCUS_IN : ADL_EVENT_FOCUS_OUT;
+      event->window = windowFindLocked(e->event);
       break;
     }
 
@@ -894,7 +973,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
         (xcb_configure_notify_event_t *)xevent;
 
       event->type   = ADL_EVENT_WINDOW_CHANGE;
-      event->window = windowFindById(e->window);
+      event->window = windowFindLocked(e->window);
 
       /* non-generated events need translating */
       if (!generated && event->window)
@@ -924,7 +1003,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
     {
       xcb_key_press_event_t * e = (xcb_key_press_event_t *)xevent;
       event->type            = ADL_EVENT_KEY_DOWN;
-      event->window          = windowFindById(e->child ? e->child : e->event);
+      event->window          = windowFindLocked(e->child ? e->child : e->event);
       event->u.key.keyname   = this.keyMap[e->detail - 8];
       event->u.key.scancode  = e->detail - 8;
       break;
@@ -934,7 +1013,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
     {
       xcb_key_release_event_t * e = (xcb_key_release_event_t *)xevent;
       event->type           = ADL_EVENT_KEY_UP;
-      event->window         = windowFindById(e->child ? e->child : e->event);
+      event->window         = windowFindLocked(e->child ? e->child : e->event);
       event->u.key.keyname  = this.keyMap[e->detail - 8];
       event->u.key.scancode = e->detail - 8;
       break;
@@ -945,7 +1024,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
       xcb_button_press_event_t * e = (xcb_button_press_event_t *)xevent;
       event->type      = ADL_EVENT_MOUSE_DOWN;
 
-      event->window    = windowFindById(e->child ? e->child : e->event);
+      event->window    = windowFindLocked(e->child ? e->child : e->event);
       WindowData *data = ADL_GET_WINDOW_DATA(event->window);
       event->u.mouse.x = e->event_x;
       event->u.mouse.y = e->event_y;
@@ -982,7 +1061,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
     {
       xcb_button_release_event_t * e = (xcb_button_release_event_t *)xevent;
       event->type      = ADL_EVENT_MOUSE_UP;
-      event->window    = windowFindById(e->child ? e->child : e->event);
+      event->window    = windowFindLocked(e->child ? e->child : e->event);
 
       WindowData *data = ADL_GET_WINDOW_DATA(event->window);
       event->u.mouse.x = e->event_x;
@@ -1009,7 +1088,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
     {
       xcb_motion_notify_event_t * e = (xcb_motion_notify_event_t *)xevent;
       event->type            = ADL_EVENT_MOUSE_MOVE;
-      event->window          = windowFindById(e->child ? e->child : e->event);
+      event->window          = windowFindLocked(e->child ? e->child : e->event);
 
       WindowData *data = ADL_GET_WINDOW_DATA(event->window);
       event->u.mouse.x       = e->event_x;
@@ -1058,7 +1137,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
       xcb_enter_notify_event_t * e = (xcb_enter_notify_event_t *)xevent;
 
       event->type   = ADL_EVENT_MOUSE_ENTER;
-      event->window = windowFindById(e->child ? e->child : e->event);
+      event->window = windowFindLocked(e->child ? e->child : e->event);
       WindowData *data = ADL_GET_WINDOW_DATA(event->window);
 
       event->u.mouse.x       = e->event_x;
@@ -1076,7 +1155,7 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
       xcb_leave_notify_event_t * e = (xcb_leave_notify_event_t *)xevent;
 
       event->type   = ADL_EVENT_MOUSE_LEAVE;
-      event->window = windowFindById(e->child ? e->child : e->event);
+      event->window = windowFindLocked(e->child ? e->child : e->event);
       WindowData *data = ADL_GET_WINDOW_DATA(event->window);
 
       event->u.mouse.x       = e->event_x;
@@ -1091,6 +1170,16 @@ static ADL_STATUS xcbProcessEvent(int timeout, ADLEvent * event)
   }
 
   free(xevent);
+
+  /* when polling only report ADL_EVENT_NONE once the queue is empty */
+  if (timeout == 0 && event->type == ADL_EVENT_NONE)
+  {
+    if (event->window)
+      windowUnlock(event->window);
+    memset(event, 0, sizeof(*event));
+    goto again;
+  }
+
   return ADL_OK;
 }
 
@@ -1240,6 +1329,8 @@ static struct ADLPlatform xcb =
   .imageCreate        = xcbImageCreate,
   .imageDestroy       = xcbImageDestroy,
   .imageUpdate        = xcbImageUpdate,
+  .imageUpdateRects   = xcbImageUpdateRects,
+  .imagePresentAt     = xcbImagePresentAt,
 
   .pointerWarp        = xcbPointerWarp,
   .pointerVisible     = xcbPointerVisible,
@@ -35,6 +35,35 @@
 #include <xcb/xcb_cursor.h>
 #include <xcb/render.h>
 
+/* byte `n` of a 32-bit pixel in memory as a shift of the pixel value */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define RF_BYTE(n) ((n) * 8)
+#else
+#define RF_BYTE(n) (24 - (n) * 8)
+#endif
+
+/* the render formats we look for, keyed by depth and channel shift/mask */
+#define RENDER_FORMATS \
+  /*            name       , depth, red              , green            , blue             , alpha            */ \
+  RENDER_FORMAT(RGB        , 24   , RF_BYTE(0), 0xff , RF_BYTE(1), 0xff , RF_BYTE(2), 0xff , 0         , 0x00 ) \
+  RENDER_FORMAT(RGBA       , 32   , RF_BYTE(0), 0xff , RF_BYTE(1), 0xff , RF_BYTE(2), 0xff , RF_BYTE(3), 0xff ) \
+  RENDER_FORMAT(ARGB       , 32   , RF_BYTE(1), 0xff , RF_BYTE(2), 0xff , RF_BYTE(3), 0xff , RF_BYTE(0), 0xff ) \
+  RENDER_FORMAT(BGR        , 24   , RF_BYTE(2), 0xff , RF_BYTE(1), 0xff , RF_BYTE(0), 0xff , 0         , 0x00 ) \
+  RENDER_FORMAT(BGRA       , 32   , RF_BYTE(2), 0xff , RF_BYTE(1), 0xff , RF_BYTE(0), 0xff , RF_BYTE(3), 0xff ) \
+  RENDER_FORMAT(ABGR       , 32   , RF_BYTE(3), 0xff , RF_BYTE(2), 0xff , RF_BYTE(1), 0xff , RF_BYTE(0), 0xff ) \
+  RENDER_FORMAT(RGB565     , 16   , 11        , 0x1f , 5         , 0x3f , 0         , 0x1f , 0         , 0x00 ) \
+  RENDER_FORMAT(XRGB2101010, 30   , 20        , 0x3ff, 10        , 0x3ff, 0         , 0x3ff, 0         , 0x00 )
+
+#define RENDER_FORMAT(name, ...) RF_ ##name,
+typedef enum
+{
+  RF_INVALID = -1,
+  RENDER_FORMATS
+  RF_COUNT
+}
+RenderFormat;
+#undef RENDER_FORMAT
+
 struct State
 {
   Display *          display;
@@ -43,8 +72,10 @@ struct State
   xcb_screen_t *     screen;
   char               keyMap[256][5];
 
-  xcb_render_pictforminfo_t formatRGB, formatRGBA, formatARGB;
-  xcb_render_pictforminfo_t formatBGR, formatBGRA, formatABGR;
+  bool havePresent;
+
+  xcb_render_pictforminfo_t formats[RF_COUNT];
+  xcb_render_pictforminfo_t visualFormat;
 
   xcb_cursor_context_t * cursorContext;
   xcb_cursor_t defaultPointer;
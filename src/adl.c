@@ -24,7 +24,12 @@
 
 #include "adl.h"
 #include "window.h"
-#include "linkedlist.h"
+#include "image.h"
+#include "upload.h"
+#include "convert.h"
+#include "event.h"
+#include "profile.h"
+#include "timer.h"
 
 #include "interface/adl.h"
 
@@ -36,7 +41,15 @@
 #include <unistd.h>
 #include <string.h>
 
-struct ADL adl = { 0 };
+/* number of items per slab chunk */
+#define ADL_SLAB_WINDOWS 8
+#define ADL_SLAB_IMAGES  32
+
+struct ADL adl =
+{
+  .windowsLock = PTHREAD_RWLOCK_INITIALIZER,
+  .slabLock    = PTHREAD_MUTEX_INITIALIZER
+};
 
 ADL_STATUS adlInitialize()
 {
@@ -141,7 +154,18 @@ ADL_STATUS adlShutdown()
 {
   ADL_INITCHECK;
 
-  adlLinkedListFree(&adl.windowList);
+  adlUploadShutdown();
+  adlConvertShutdown();
+  timerShutdown();
+
+  /* free from the end so no items are moved */
+  while(adl.windows.count)
+    windowFree(adl.windows.items[adl.windows.count - 1]);
+  adlHandleTableFree(&adl.windows);
+  eventQueueClear(NULL);
+
+  adlSlabFree(&adl.imageSlab);
+  adlSlabFree(&adl.windowSlab);
   return ADL_OK;
 }
 
@@ -153,7 +177,15 @@ ADL_STATUS adlQuit()
     .type = ADL_EVENT_QUIT
   };
 
-  adlLinkedListIterate(&adl.windowList, windowListItemEvent, &event);
+  adlWindowsLock(false);
+  for(uint32_t i = 0; i < adl.windows.count; ++i)
+  {
+    ADLWindowItem * item = adl.windows.items[i];
+    windowLock(&item->window);
+    adl.platform->windowEvent(&item->window, &event);
+    windowUnlock(&item->window);
+  }
+  adlWindowsUnlock();
   return ADL_OK;
 }
 
@@ -199,12 +231,23 @@ ADL_STATUS adlUsePlatform(const char * name)
     return ADL_ERR_INVALID_PLATFORM;
   }
 
+  if (adl.profile)
+    adl.platform = adlProfileWrap(adl.platform);
+
+  const size_t windowSize =
+    sizeof(ADLWindowItem) + adl.platform->windowDataSize;
+  const size_t imageSize  =
+    sizeof(ADLImageItem ) + adl.platform->imageDataSize;
+
   ADL_STATUS status;
-  if ((status = adlLinkedListNew(
-          sizeof(ADLWindowListItem) + adl.platform->windowDataSize,
-          windowListItemDestructor, &adl.windowList)) != ADL_OK)
+  if ((status = adlSlabNew(windowSize, ADL_SLAB_WINDOWS,
+          &adl.windowSlab)) != ADL_OK ||
+      (status = adlSlabNew(imageSize, ADL_SLAB_IMAGES,
+          &adl.imageSlab)) != ADL_OK)
     return status;
 
+  adlHandleTableNew(&adl.windows);
+
   if ((status = adl.platform->init()) != ADL_OK)
   {
     ADL_ERROR(status, "Platform `%s` initialization failed", name);
@@ -221,134 +264,99 @@ ADL_STATUS adlProcessEvent(int timeout, ADLEvent * event)
   ADL_NOT_NULL_CHECK(event);
   ADL_STATUS status;
 
-  memset(event, 0, sizeof(ADLEvent));
+  /* return events queued by adlPeekEvents first */
+  if (eventQueuePop(event))
+    return ADL_OK;
 
-  if ((status = adl.platform->processEvent(timeout, event)) != ADL_OK)
-    return status;
+  memset(event, 0, sizeof(ADLEvent));
 
-  if (event->type == ADL_EVENT_NONE)
-    return status;
+  /* expired timers are delivered before waiting on the platform which also
+   * wakes when a timer expires */
+  if (timerPollEvent(event))
+    return ADL_OK;
 
-  ADLWindow * window = event->window;
-  switch(event->type)
   {
-    case ADL_EVENT_SHOW:
-      if (!window)
-        break;
-
-      if (window->visible)
-      {
-        // swallow repeat events
-        event->type = ADL_EVENT_NONE;
-        break;
-      }
-      window->visible = true;
-      break;
-
-    case ADL_EVENT_HIDE:
-      if (!window)
-        break;
-
-      if (!window->visible)
-      {
-        // swallow repeat events
-        event->type = ADL_EVENT_NONE;
-        break;
-      }
-      window->visible = false;
-      break;
-
-    case ADL_EVENT_MOUSE_MOVE :
-    case ADL_EVENT_MOUSE_DOWN :
-    case ADL_EVENT_MOUSE_UP   :
-    case ADL_EVENT_MOUSE_ENTER:
-    case ADL_EVENT_MOUSE_LEAVE:
-      if (!window)
-        break;
-
-      // fill in the relX and relY fields
-      if (!window->haveMousePos)
-      {
-        window->haveMousePos = true;
-        window->mouseX       = event->u.mouse.x;
-        window->mouseY       = event->u.mouse.y;
-        event->u.mouse.relX  = 0;
-        event->u.mouse.relY  = 0;
-        break;
-      }
+    ADL_TRACE_SCOPE("processEvent");
+    ADL_AUDIT_EVENT(true);
+    status = adl.platform->processEvent(timeout, event);
+    ADL_AUDIT_EVENT(false);
+  }
 
-      event->u.mouse.relX = event->u.mouse.x - window->mouseX;
-      event->u.mouse.relY = event->u.mouse.y - window->mouseY;
+  /* the platform returns with the event's window locked */
+  if (status != ADL_OK)
+  {
+    if (event->window)
+      windowUnlock(event->window);
+    return status;
+  }
 
-      // if the mouse was warped null it out
-      if (event->u.mouse.warp)
-      {
-        event->u.mouse.relX -= event->u.mouse.warpX;
-        event->u.mouse.relY -= event->u.mouse.warpY;
-      }
+  if (event->type == ADL_EVENT_NONE && timerPollEvent(event))
+    return ADL_OK;
 
-      // if there has been no change, swallow the event
-      if (event->type == ADL_EVENT_MOUSE_MOVE &&
-          event->u.mouse.relX    == 0 &&
-          event->u.mouse.relY    == 0 &&
-          event->u.mouse.x       == window->mouseX &&
-          event->u.mouse.y       == window->mouseY &&
-          event->u.mouse.warping == window->mouseWarping &&
-          event->u.mouse.warp    == window->mouseWarp)
-        event->type = ADL_EVENT_NONE;
-
-      window->mouseX       = event->u.mouse.x;
-      window->mouseY       = event->u.mouse.y;
-      window->mouseWarping = event->u.mouse.warping;
-      window->mouseWarp    = event->u.mouse.warp;
-      break;
+  eventTranslate(event);
+  if (event->window)
+    windowUnlock(event->window);
+  return status;
+}
 
-    case ADL_EVENT_WINDOW_CHANGE:
-      if (!window)
-        break;
+ADL_STATUS adlFlush()
+{
+  ADL_INITCHECK;
+  ADL_TRACE_SCOPE("flush");
+  return adl.platform->flush();
+}
 
-      if (!(window->x != event->u.win.x ||
-            window->y != event->u.win.y ||
-            window->w != event->u.win.w ||
-            window->h != event->u.win.h))
-      {
-        event->type = ADL_EVENT_NONE;
-        break;
-      }
+ADL_STATUS adlGetAllocStats(ADLAllocStats * windows, ADLAllocStats * images)
+{
+  ADL_INITCHECK;
 
-      window->x = event->u.win.x;
-      window->y = event->u.win.y;
-      window->w = event->u.win.w;
-      window->h = event->u.win.h;
-      break;
+  adlSlabLock();
+  if (windows)
+    *windows = adl.windowSlab.stats;
 
-    default:
-      break;
-  }
+  if (images)
+    *images = adl.imageSlab.stats;
+  adlSlabUnlock();
 
-  return status;
+  return ADL_OK;
 }
 
-ADL_STATUS adlFlush()
+ADL_STATUS adlSetThreadSafe(bool enable)
 {
   ADL_INITCHECK;
-  return adl.platform->flush();
+
+  if (adl.platform)
+  {
+    ADL_ERROR(ADL_ERR_BUSY, "must be called before adlUsePlatform");
+    return ADL_ERR_BUSY;
+  }
+
+  adl.threadSafe = enable;
+  return ADL_OK;
 }
 
 ADL_STATUS adlPointerWarp(ADLWindow * window, int x, int y)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
+  ADL_WINDOW_CHECK(window);
 
-  return adl.platform->pointerWarp(window, x, y);
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->pointerWarp(window, x, y);
+  windowUnlock(window);
+  return status;
 }
 
 ADL_STATUS adlPointerVisible(ADLWindow * window, bool visible)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
+  ADL_WINDOW_CHECK(window);
 
-  return adl.platform->pointerVisible(window, visible);
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->pointerVisible(window, visible);
+  windowUnlock(window);
+  return status;
 }
 
 ADL_STATUS adlPointerSetCursor(ADLWindow * window, ADLImage * source,
@@ -356,8 +364,23 @@ ADL_STATUS adlPointerSetCursor(ADLWindow * window, ADLImage * source,
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
+  ADL_WINDOW_CHECK(window);
 
-  return adl.platform->pointerSetCursor(window, source, mask, x, y);
+  if (source)
+  {
+    ADL_IMAGE_CHECK(source);
+  }
+
+  if (mask)
+  {
+    ADL_IMAGE_CHECK(mask);
+  }
+
+  windowLock(window);
+  const ADL_STATUS status =
+    adl.platform->pointerSetCursor(window, source, mask, x, y);
+  windowUnlock(window);
+  return status;
 }
 
 #if defined(ADL_HAS_EGL)
@@ -372,8 +395,12 @@ ADL_STATUS adlEGLCreateWindowSurface(EGLDisplay * display, EGLint * config,
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
+  ADL_WINDOW_CHECK(window);
 
-  return adl.platform->eglCreateWindowSurface(
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->eglCreateWindowSurface(
     display, config, window, attribs, surface);
+  windowUnlock(window);
+  return status;
 }
 #endif
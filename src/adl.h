@@ -27,10 +27,14 @@
 
 #include "window.h"
 #include "interface/adl.h"
-#include "linkedlist.h"
+#include "handle.h"
+#include "slab.h"
+#include "audit.h"
+#include "trace.h"
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
 #define ENDIAN_LITTLE
@@ -48,13 +52,52 @@ struct ADL
   int                         numPlatforms;
 
   const struct ADLPlatform * platform;
+  bool                       profile;
 
-  ADLLinkedList windowList;
+  /* the locks are only taken if thread-safe mode is enabled, `windowsLock`
+   * is taken before any window's lock */
+  bool             threadSafe;
+  pthread_rwlock_t windowsLock;
+  pthread_mutex_t  slabLock;
+
+  ADLHandleTable windows;
+  ADLSlab        windowSlab;
+  ADLSlab        imageSlab;
 };
 
 extern struct ADL adl;
 
+static inline void adlWindowsLock(bool write)
+{
+  if (!adl.threadSafe)
+    return;
+
+  if (write)
+    pthread_rwlock_wrlock(&adl.windowsLock);
+  else
+    pthread_rwlock_rdlock(&adl.windowsLock);
+}
+
+static inline void adlWindowsUnlock(void)
+{
+  if (adl.threadSafe)
+    pthread_rwlock_unlock(&adl.windowsLock);
+}
+
+static inline void adlSlabLock(void)
+{
+  if (adl.threadSafe)
+    pthread_mutex_lock(&adl.slabLock);
+}
+
+static inline void adlSlabUnlock(void)
+{
+  if (adl.threadSafe)
+    pthread_mutex_unlock(&adl.slabLock);
+}
+
 #define ADL_INITCHECK \
+  ADL_AUDIT_API; \
   if (!adl.initDone) \
   { \
     ADL_ERROR(ADL_ERR_NOT_INITIALIZED, "not initialized"); \
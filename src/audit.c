@@ -0,0 +1,138 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "audit.h"
+#include "adl.h"
+
+#include <string.h>
+
+#if defined(ADL_AUDIT)
+
+#include <pthread.h>
+#include <inttypes.h>
+
+#define AUDIT_MAX_SITES 64
+
+_Thread_local const char * adlAuditAPI;
+_Thread_local bool         adlAuditInEvent;
+
+static struct
+{
+  pthread_mutex_t   lock;
+  ADLPlatformStats  total;
+  ADLRoundTripStats sites[AUDIT_MAX_SITES];
+  unsigned int      siteCount;
+}
+audit = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void auditAdd(uint64_t * count, uint64_t * inEvent, uint64_t * totalNS,
+    uint64_t * histogram, unsigned int bucket, uint64_t waitNS)
+{
+  ++*count;
+  *inEvent += adlAuditInEvent;
+  *totalNS += waitNS;
+  ++histogram[bucket];
+}
+
+void adlAuditRecord(const char * call, const char * file, unsigned int line,
+    uint64_t waitNS)
+{
+  const char * api = adlAuditAPI;
+
+  /* bucket n holds waits of [2^(n-1), 2^n) microseconds */
+  const uint64_t us     = waitNS / 1000;
+  unsigned int   bucket = us ? 64 - __builtin_clzll(us) : 0;
+  if (bucket >= ADL_STATS_BUCKETS)
+    bucket = ADL_STATS_BUCKETS - 1;
+
+  bool first = false;
+
+  pthread_mutex_lock(&audit.lock);
+
+  ADLPlatformStats * t = &audit.total;
+  auditAdd(&t->count, &t->inEvent, &t->totalNS, t->histogram, bucket, waitNS);
+
+  /* the strings are literals so the pointers identify the site */
+  ADLRoundTripStats * s = NULL;
+  for(unsigned int i = 0; i < audit.siteCount; ++i)
+    if (audit.sites[i].line == line && audit.sites[i].file == file &&
+        audit.sites[i].api  == api)
+    {
+      s = &audit.sites[i];
+      break;
+    }
+
+  if (!s && audit.siteCount < AUDIT_MAX_SITES)
+  {
+    s = &audit.sites[audit.siteCount++];
+    s->call = call;
+    s->file = file;
+    s->line = line;
+    s->api  = api;
+  }
+
+  if (s)
+  {
+    first = adlAuditInEvent && !s->inEvent;
+    auditAdd(&s->count, &s->inEvent, &s->totalNS, s->histogram, bucket,
+        waitNS);
+    if (waitNS > s->maxNS)
+      s->maxNS = waitNS;
+  }
+
+  pthread_mutex_unlock(&audit.lock);
+
+  if (first)
+    ADL_WARN(ADL_OK, "%s:%u %s blocked for %" PRIu64 "us inside "
+        "adlProcessEvent", file, line, call, us);
+}
+
+ADL_STATUS adlGetPlatformStats(ADLPlatformStats * stats,
+    ADLRoundTripStats * sites, unsigned int maxSites)
+{
+  ADL_NOT_NULL_CHECK(stats);
+
+  pthread_mutex_lock(&audit.lock);
+  *stats           = audit.total;
+  stats->siteCount = audit.siteCount;
+  if (sites)
+    memcpy(sites, audit.sites, sizeof(*sites) *
+        (maxSites < audit.siteCount ? maxSites : audit.siteCount));
+  pthread_mutex_unlock(&audit.lock);
+
+  return ADL_OK;
+}
+
+#else
+
+ADL_STATUS adlGetPlatformStats(ADLPlatformStats * stats,
+    ADLRoundTripStats * sites, unsigned int maxSites)
+{
+  ADL_NOT_NULL_CHECK(stats);
+  memset(stats, 0, sizeof(*stats));
+  return ADL_ERR_UNSUPPORTED;
+}
+
+#endif
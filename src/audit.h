@@ -0,0 +1,77 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_AUDIT
+#define _H_SRC_AUDIT
+
+#include "adl/util.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(ADL_AUDIT)
+
+/* the public ADL function the current thread is in, set by ADL_INITCHECK and
+ * restored when that function returns */
+extern _Thread_local const char * adlAuditAPI;
+/* set while the current thread is inside adlProcessEvent */
+extern _Thread_local bool adlAuditInEvent;
+
+void adlAuditRecord(const char * call, const char * file, unsigned int line,
+    uint64_t waitNS);
+
+/* time a blocking platform call and record it against the call site */
+#define ADL_AUDIT_WAIT(fn, ...) \
+  ({ \
+    const uint64_t __start = adlGetClockNS(); \
+    typeof(fn(__VA_ARGS__)) __ret = fn(__VA_ARGS__); \
+    adlAuditRecord(#fn, STRIPPATH(__FILE__), __LINE__, \
+        adlGetClockNS() - __start); \
+    __ret; \
+  })
+
+static inline void adlAuditLeave(const char ** prev)
+{
+  adlAuditAPI = *prev;
+}
+
+/* scoped to the enclosing function, restores the caller's value on return so
+ * later waits on this thread are not attributed to a function that has
+ * already returned */
+#define ADL_AUDIT_API \
+  const char * __adlAuditPrev __attribute__((cleanup(adlAuditLeave))) = \
+    adlAuditAPI; \
+  adlAuditAPI = __func__
+#define ADL_AUDIT_EVENT(x) adlAuditInEvent = (x)
+
+#else
+
+#define ADL_AUDIT_WAIT(fn, ...) fn(__VA_ARGS__)
+#define ADL_AUDIT_API
+#define ADL_AUDIT_EVENT(x)
+
+#endif
+
+#endif
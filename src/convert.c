@@ -0,0 +1,370 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "convert.h"
+#include "adl.h"
+
+#include "adl/job.h"
+
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* images with at least this many pixels are converted in parallel */
+#define CONVERT_MT_THRESHOLD (1920 * 1080)
+
+/* the workers are started by the first parallel conversion */
+static struct
+{
+  pthread_mutex_t lock;
+  ADLJobSystem  * jobs;
+  bool            failed;
+}
+convert =
+{
+  .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* limited range coefficients in Q6 fixed point, small enough that every
+ * intermediate fits in a signed 16-bit lane */
+typedef struct
+{
+  int16_t y, rv, gu, gv, bu;
+}
+Coefficients;
+
+static const Coefficients coefficients[] =
+{
+  [ADL_IMAGE_COLORSPACE_BT601] = {.y = 75, .rv = 102, .gu = 25, .gv = 52, .bu = 129},
+  [ADL_IMAGE_COLORSPACE_BT709] = {.y = 75, .rv = 115, .gu = 14, .gv = 34, .bu = 135}
+};
+
+typedef struct
+{
+  const ADLImageDef * def;
+  const uint8_t     * src;
+  uint8_t           * dst;
+  unsigned int        dstPitch;
+  unsigned int        y0, y1;
+}
+ConvertJob;
+
+bool adlConvertIsYUV(const ADLImageFormat format)
+{
+  return
+    format == ADL_IMAGE_FORMAT_NV12 ||
+    format == ADL_IMAGE_FORMAT_I420;
+}
+
+bool adlConvertIsSupported(const ADLImageFormat format)
+{
+  return
+    adlConvertIsYUV(format) ||
+    format == ADL_IMAGE_FORMAT_RGB565 ||
+    format == ADL_IMAGE_FORMAT_XRGB2101010;
+}
+
+ADL_STATUS adlConvertCheckYUV(const ADLImageDef * def)
+{
+  const unsigned int cw = (def->w + 1) / 2;
+
+  if (def->colorSpace != ADL_IMAGE_COLORSPACE_BT601 &&
+      def->colorSpace != ADL_IMAGE_COLORSPACE_BT709)
+  {
+    ADL_ERROR(ADL_ERR_INVALID_ARGUMENT, "invalid colorSpace");
+    return ADL_ERR_INVALID_ARGUMENT;
+  }
+
+  if (def->planes[0].pitch < def->w)
+  {
+    ADL_ERROR(ADL_ERR_INVALID_ARGUMENT, "Y plane pitch is too small");
+    return ADL_ERR_INVALID_ARGUMENT;
+  }
+
+  switch(def->format)
+  {
+    case ADL_IMAGE_FORMAT_NV12:
+      if (def->planes[1].pitch < cw * 2)
+      {
+        ADL_ERROR(ADL_ERR_INVALID_ARGUMENT, "UV plane pitch is too small");
+        return ADL_ERR_INVALID_ARGUMENT;
+      }
+      return ADL_OK;
+
+    case ADL_IMAGE_FORMAT_I420:
+      if (def->planes[1].pitch < cw || def->planes[2].pitch < cw)
+      {
+        ADL_ERROR(ADL_ERR_INVALID_ARGUMENT, "U/V plane pitch is too small");
+        return ADL_ERR_INVALID_ARGUMENT;
+      }
+      return ADL_OK;
+
+    default:
+      return ADL_ERR_UNSUPPORTED_FORMAT;
+  }
+}
+
+static inline uint8_t clamp(const int v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/* convert a single row, `u` and `v` point to the chroma row, if `interleaved`
+ * is set `u` points to the UV pairs and `v` is ignored */
+static void convertRow(const Coefficients * c, const uint8_t * y,
+    const uint8_t * u, const uint8_t * v, bool interleaved, uint8_t * dst,
+    const unsigned int w)
+{
+  unsigned int x = 0;
+
+#if defined(__SSE2__)
+  const __m128i zero  = _mm_setzero_si128();
+  const __m128i alpha = _mm_set1_epi8(-1);
+  const __m128i mask  = _mm_set1_epi16(0x00ff);
+  const __m128i y16   = _mm_set1_epi16(16);
+  const __m128i c128  = _mm_set1_epi16(128);
+  const __m128i round = _mm_set1_epi16(32);
+  const __m128i cy    = _mm_set1_epi16(c->y );
+  const __m128i crv   = _mm_set1_epi16(c->rv);
+  const __m128i cgu   = _mm_set1_epi16(c->gu);
+  const __m128i cgv   = _mm_set1_epi16(c->gv);
+  const __m128i cbu   = _mm_set1_epi16(c->bu);
+
+  for(; x + 16 <= w; x += 16, dst += 64)
+  {
+    /* 8 chroma samples cover 16 pixels */
+    __m128i cu, cv;
+    if (interleaved)
+    {
+      const __m128i uv = _mm_loadu_si128((const __m128i *)(u + x));
+      cu = _mm_and_si128 (uv, mask);
+      cv = _mm_srli_epi16(uv, 8);
+    }
+    else
+    {
+      cu = _mm_unpacklo_epi8(
+          _mm_loadl_epi64((const __m128i *)(u + (x >> 1))), zero);
+      cv = _mm_unpacklo_epi8(
+          _mm_loadl_epi64((const __m128i *)(v + (x >> 1))), zero);
+    }
+
+    cu = _mm_sub_epi16(cu, c128);
+    cv = _mm_sub_epi16(cv, c128);
+
+    const __m128i rc = _mm_mullo_epi16(cv, crv);
+    const __m128i bc = _mm_mullo_epi16(cu, cbu);
+    const __m128i gc = _mm_add_epi16(
+        _mm_mullo_epi16(cu, cgu),
+        _mm_mullo_epi16(cv, cgv));
+
+    const __m128i yy  = _mm_loadu_si128((const __m128i *)(y + x));
+    const __m128i ylo = _mm_add_epi16(_mm_mullo_epi16(
+          _mm_sub_epi16(_mm_unpacklo_epi8(yy, zero), y16), cy), round);
+    const __m128i yhi = _mm_add_epi16(_mm_mullo_epi16(
+          _mm_sub_epi16(_mm_unpackhi_epi8(yy, zero), y16), cy), round);
+
+    /* each chroma sample is shared by two horizontal pixels */
+    const __m128i r = _mm_packus_epi16(
+        _mm_srai_epi16(_mm_adds_epi16(ylo, _mm_unpacklo_epi16(rc, rc)), 6),
+        _mm_srai_epi16(_mm_adds_epi16(yhi, _mm_unpackhi_epi16(rc, rc)), 6));
+    const __m128i g = _mm_packus_epi16(
+        _mm_srai_epi16(_mm_subs_epi16(ylo, _mm_unpacklo_epi16(gc, gc)), 6),
+        _mm_srai_epi16(_mm_subs_epi16(yhi, _mm_unpackhi_epi16(gc, gc)), 6));
+    const __m128i b = _mm_packus_epi16(
+        _mm_srai_epi16(_mm_adds_epi16(ylo, _mm_unpacklo_epi16(bc, bc)), 6),
+        _mm_srai_epi16(_mm_adds_epi16(yhi, _mm_unpackhi_epi16(bc, bc)), 6));
+
+    const __m128i bglo = _mm_unpacklo_epi8(b, g);
+    const __m128i bghi = _mm_unpackhi_epi8(b, g);
+    const __m128i ralo = _mm_unpacklo_epi8(r, alpha);
+    const __m128i rahi = _mm_unpackhi_epi8(r, alpha);
+
+    _mm_storeu_si128((__m128i *)(dst +  0), _mm_unpacklo_epi16(bglo, ralo));
+    _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(bglo, ralo));
+    _mm_storeu_si128((__m128i *)(dst + 32), _mm_unpacklo_epi16(bghi, rahi));
+    _mm_storeu_si128((__m128i *)(dst + 48), _mm_unpackhi_epi16(bghi, rahi));
+  }
+#endif
+
+  for(; x < w; ++x, dst += 4)
+  {
+    int cu, cv;
+    if (interleaved)
+    {
+      cu = u[(x & ~1U) + 0] - 128;
+      cv = u[(x & ~1U) + 1] - 128;
+    }
+    else
+    {
+      cu = u[x >> 1] - 128;
+      cv = v[x >> 1] - 128;
+    }
+
+    const int yy = (y[x] - 16) * c->y + 32;
+    dst[0] = clamp((yy + cu * c->bu) >> 6);
+    dst[1] = clamp((yy - cu * c->gu - cv * c->gv) >> 6);
+    dst[2] = clamp((yy + cv * c->rv) >> 6);
+    dst[3] = 0xff;
+  }
+}
+
+static void convertRowRGB565(const uint16_t * src, uint8_t * dst,
+    const unsigned int w)
+{
+  for(unsigned int x = 0; x < w; ++x, dst += 4)
+  {
+    const unsigned int p = src[x];
+    const unsigned int r = (p >> 11) & 0x1f;
+    const unsigned int g = (p >>  5) & 0x3f;
+    const unsigned int b = (p >>  0) & 0x1f;
+    dst[0] = (b << 3) | (b >> 2);
+    dst[1] = (g << 2) | (g >> 4);
+    dst[2] = (r << 3) | (r >> 2);
+    dst[3] = 0xff;
+  }
+}
+
+static void convertRowXRGB2101010(const uint32_t * src, uint8_t * dst,
+    const unsigned int w)
+{
+  for(unsigned int x = 0; x < w; ++x, dst += 4)
+  {
+    const uint32_t p = src[x];
+    dst[0] = p >>  2;
+    dst[1] = p >> 12;
+    dst[2] = p >> 22;
+    dst[3] = 0xff;
+  }
+}
+
+static void convertRowsPacked(const ConvertJob * job)
+{
+  const ADLImageDef * def = job->def;
+
+  for(unsigned int y = job->y0; y < job->y1; ++y)
+  {
+    const void * src = job->src + y * def->pitch;
+    uint8_t    * dst = job->dst + y * job->dstPitch;
+
+    if (def->format == ADL_IMAGE_FORMAT_RGB565)
+      convertRowRGB565(src, dst, def->w);
+    else
+      convertRowXRGB2101010(src, dst, def->w);
+  }
+}
+
+static void convertRowsYUV(const ConvertJob * job)
+{
+  const ADLImageDef  * def = job->def;
+  const ADLImagePlane * p  = def->planes;
+  const Coefficients  * c  = &coefficients[def->colorSpace];
+  const bool interleaved   = def->format == ADL_IMAGE_FORMAT_NV12;
+
+  for(unsigned int y = job->y0; y < job->y1; ++y)
+  {
+    const unsigned int cy = y >> 1;
+    const uint8_t * u = job->src + p[1].offset + cy * p[1].pitch;
+    const uint8_t * v = interleaved ? NULL :
+      job->src + p[2].offset + cy * p[2].pitch;
+
+    convertRow(c,
+      job->src + p[0].offset + y * p[0].pitch,
+      u, v, interleaved,
+      job->dst + y * job->dstPitch,
+      def->w);
+  }
+}
+
+static void convertRows(const ConvertJob * job)
+{
+  if (adlConvertIsYUV(job->def->format))
+    convertRowsYUV(job);
+  else
+    convertRowsPacked(job);
+}
+
+static void convertRange(unsigned int start, unsigned int end, void * udata)
+{
+  ConvertJob job = *(const ConvertJob *)udata;
+  job.y0 = start;
+  job.y1 = end;
+  convertRows(&job);
+}
+
+static ADLJobSystem * convertGetJobs(void)
+{
+  ADL_STATUS status;
+
+  pthread_mutex_lock(&convert.lock);
+  if (!convert.jobs && !convert.failed &&
+      (status = adlJobSystemCreate(0, &convert.jobs)) != ADL_OK)
+  {
+    ADL_WARN(status, "failed to start the conversion workers, converting "
+        "serially");
+    convert.failed = true;
+  }
+  ADLJobSystem * jobs = convert.jobs;
+  pthread_mutex_unlock(&convert.lock);
+  return jobs;
+}
+
+void adlConvertToBGRX(const ADLImageDef * def, const void * src,
+    void * dst, unsigned int dstPitch)
+{
+  ADL_TRACE_SCOPE("convertToBGRX");
+
+  const ConvertJob job =
+  {
+    .def      = def,
+    .src      = src,
+    .dst      = dst,
+    .dstPitch = dstPitch,
+    .y0       = 0,
+    .y1       = def->h
+  };
+
+  ADLJobSystem * jobs;
+  if (def->w * def->h < CONVERT_MT_THRESHOLD ||
+      !(jobs = convertGetJobs()) || adlJobSystemGetWorkers(jobs) < 2)
+  {
+    convertRows(&job);
+    return;
+  }
+
+  /* the calling thread converts rows too while it waits */
+  ADLJobCounter counter = { 0 };
+  adlJobParallelFor(jobs, def->h, 0, convertRange, (void *)&job, &counter);
+  adlJobWait(jobs, &counter);
+}
+
+void adlConvertShutdown(void)
+{
+  pthread_mutex_lock(&convert.lock);
+  adlJobSystemDestroy(&convert.jobs);
+  convert.failed = false;
+  pthread_mutex_unlock(&convert.lock);
+}
@@ -0,0 +1,60 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_CONVERT
+#define _H_SRC_CONVERT
+
+#include "adl/image.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* returns true if the format is a planar YUV format */
+bool adlConvertIsYUV(const ADLImageFormat format);
+
+/* returns true if the format can be converted by adlConvertToBGRX */
+bool adlConvertIsSupported(const ADLImageFormat format);
+
+/* validates the plane layout of a YUV image definition */
+ADL_STATUS adlConvertCheckYUV(const ADLImageDef * def);
+
+/**
+ * Convert an image to 32-bit BGRX (0xXXRRGGBB in native byte order)
+ *
+ * @param def      The definition of the source image
+ * @param src      The source buffer the plane offsets are relative to
+ * @param dst      The destination buffer
+ * @param dstPitch The number of bytes in a single row of the destination
+ *
+ * Large images are split into row ranges that are converted in parallel on
+ * the conversion job system.
+ */
+void adlConvertToBGRX(const ADLImageDef * def, const void * src,
+    void * dst, unsigned int dstPitch);
+
+/* stop the conversion workers */
+void adlConvertShutdown(void);
+
+#endif
@@ -0,0 +1,175 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "diff.h"
+#include "adl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+ADL_STATUS adlDiffNew(unsigned int w, unsigned int h, unsigned int pitch,
+    unsigned int bpp, const void * initial, ADLDiff ** result)
+{
+  ADLDiff * diff = calloc(1, sizeof(ADLDiff));
+  if (!diff)
+    goto err_nomem;
+
+  diff->w      = w;
+  diff->h      = h;
+  diff->pitch  = pitch;
+  diff->bpp    = bpp;
+  diff->tilesX = (w + ADL_DIFF_TILE_SIZE - 1) / ADL_DIFF_TILE_SIZE;
+  diff->tilesY = (h + ADL_DIFF_TILE_SIZE - 1) / ADL_DIFF_TILE_SIZE;
+
+  diff->prev  = malloc((size_t)w * bpp * h);
+  diff->rects = malloc(sizeof(ADLRect) * diff->tilesX * diff->tilesY);
+  if (!diff->prev || !diff->rects)
+    goto err_free;
+
+  const uint8_t * src = initial;
+  for(unsigned int y = 0; y < h; ++y)
+    memcpy(diff->prev + y * w * bpp, src + y * pitch, w * bpp);
+
+  *result = diff;
+  return ADL_OK;
+
+err_free:
+  adlDiffFree(&diff);
+err_nomem:
+  ADL_ERROR(ADL_ERR_NO_MEM, "failed to allocate the diff state");
+  return ADL_ERR_NO_MEM;
+}
+
+void adlDiffFree(ADLDiff ** diff)
+{
+  if (!*diff)
+    return;
+
+  free((*diff)->prev);
+  free((*diff)->rects);
+  free(*diff);
+  *diff = NULL;
+}
+
+static bool rowDiffers(const uint8_t * a, const uint8_t * b, unsigned int len)
+{
+#if defined(__SSE2__)
+  for(; len >= 64; len -= 64, a += 64, b += 64)
+  {
+    const __m128i c0 = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *)(a +  0)),
+        _mm_loadu_si128((const __m128i *)(b +  0)));
+    const __m128i c1 = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *)(a + 16)),
+        _mm_loadu_si128((const __m128i *)(b + 16)));
+    const __m128i c2 = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *)(a + 32)),
+        _mm_loadu_si128((const __m128i *)(b + 32)));
+    const __m128i c3 = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *)(a + 48)),
+        _mm_loadu_si128((const __m128i *)(b + 48)));
+
+    const __m128i any = _mm_or_si128(_mm_or_si128(c0, c1), _mm_or_si128(c2, c3));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xffff)
+      return true;
+  }
+
+  for(; len >= 16; len -= 16, a += 16, b += 16)
+  {
+    const __m128i eq = _mm_cmpeq_epi8(
+        _mm_loadu_si128((const __m128i *)a),
+        _mm_loadu_si128((const __m128i *)b));
+    if (_mm_movemask_epi8(eq) != 0xffff)
+      return true;
+  }
+#endif
+
+  return len && memcmp(a, b, len) != 0;
+}
+
+unsigned int adlDiffUpdate(ADLDiff * diff, const void * frame,
+    const ADLRect ** rects)
+{
+  ADL_TRACE_SCOPE("diffUpdate");
+
+  const unsigned int prevPitch = diff->w * diff->bpp;
+  unsigned int count = 0;
+
+  diff->dirtyTiles = 0;
+
+  for(unsigned int ty = 0; ty < diff->tilesY; ++ty)
+  {
+    const unsigned int y0 = ty * ADL_DIFF_TILE_SIZE;
+    unsigned int rows = diff->h - y0;
+    if (rows > ADL_DIFF_TILE_SIZE)
+      rows = ADL_DIFF_TILE_SIZE;
+
+    ADLRect * run = NULL;
+    for(unsigned int tx = 0; tx < diff->tilesX; ++tx)
+    {
+      const unsigned int x0 = tx * ADL_DIFF_TILE_SIZE;
+      unsigned int cols = diff->w - x0;
+      if (cols > ADL_DIFF_TILE_SIZE)
+        cols = ADL_DIFF_TILE_SIZE;
+
+      const unsigned int offset = x0 * diff->bpp;
+      const unsigned int len    = cols * diff->bpp;
+      const uint8_t * src = (const uint8_t *)frame + y0 * diff->pitch + offset;
+      uint8_t       * dst = diff->prev + y0 * prevPitch + offset;
+
+      /* find the first row that differs, if any */
+      unsigned int y = 0;
+      for(; y < rows; ++y)
+        if (rowDiffers(src + y * diff->pitch, dst + y * prevPitch, len))
+          break;
+
+      if (y == rows)
+      {
+        run = NULL;
+        continue;
+      }
+
+      /* rows before `y` are known to match */
+      for(; y < rows; ++y)
+        memcpy(dst + y * prevPitch, src + y * diff->pitch, len);
+
+      ++diff->dirtyTiles;
+      if (run)
+        run->w += cols;
+      else
+      {
+        run  = &diff->rects[count++];
+        *run = (ADLRect){ .x = x0, .y = y0, .w = cols, .h = rows };
+      }
+    }
+  }
+
+  *rects = diff->rects;
+  return count;
+}
@@ -0,0 +1,77 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_DIFF
+#define _H_SRC_DIFF
+
+#include "adl/image.h"
+
+#include <stdint.h>
+
+/* the width and height of a tile in pixels */
+#define ADL_DIFF_TILE_SIZE 64
+
+typedef struct
+{
+  unsigned int w, h;
+  unsigned int pitch;          // pitch of the frames passed to adlDiffUpdate
+  unsigned int bpp;            // bytes per pixel
+  unsigned int tilesX, tilesY;
+
+  uint8_t * prev;              // copy of the last frame, packed rows
+  ADLRect * rects;             // tilesX * tilesY entries
+  unsigned int dirtyTiles;     // tiles that changed in the last update
+}
+ADLDiff;
+
+/**
+ * Create a new diff state
+ *
+ * @param w       Width of the frames in pixels
+ * @param h       Height of the frames in pixels
+ * @param pitch   Number of bytes in a single row of a frame
+ * @param bpp     Number of bytes per pixel
+ * @param initial The first frame
+ * @param result  The new diff state
+ */
+ADL_STATUS adlDiffNew(unsigned int w, unsigned int h, unsigned int pitch,
+    unsigned int bpp, const void * initial, ADLDiff ** result);
+
+void adlDiffFree(ADLDiff ** diff);
+
+/**
+ * Compare a frame against the last one and store it for the next call
+ *
+ * @param diff  The diff state
+ * @param frame The new frame
+ * @param rects Set to the list of changed rectangles, valid until the next call
+ *
+ * Returns the number of changed rectangles, horizontally adjacent tiles are
+ * merged into a single rectangle.
+ */
+unsigned int adlDiffUpdate(ADLDiff * diff, const void * frame,
+    const ADLRect ** rects);
+
+#endif
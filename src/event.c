@@ -0,0 +1,369 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "event.h"
+#include "adl.h"
+#include "window.h"
+#include "timer.h"
+
+#include <string.h>
+#include <pthread.h>
+
+/* in thread-safe mode windows and timers may be destroyed on other threads
+ * which removes their events, the lock is taken after the window and timer
+ * locks and never held across a call into the platform */
+static struct
+{
+  pthread_mutex_t lock;
+  ADLEvent        events[ADL_EVENT_QUEUE_SIZE];
+  unsigned int    head;
+  unsigned int    count;
+}
+queue =
+{
+  .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static inline void queueLock(void)
+{
+  if (adl.threadSafe)
+    pthread_mutex_lock(&queue.lock);
+}
+
+static inline void queueUnlock(void)
+{
+  if (adl.threadSafe)
+    pthread_mutex_unlock(&queue.lock);
+}
+
+#define QUEUE_AT(i) (&queue.events[(queue.head + (i)) % ADL_EVENT_QUEUE_SIZE])
+
+void eventTranslate(ADLEvent * event)
+{
+  if (event->type == ADL_EVENT_NONE)
+    return;
+
+  ADL_TRACE_SCOPE("eventTranslate");
+
+  ADLWindow * window = event->window;
+  switch(event->type)
+  {
+    case ADL_EVENT_SHOW:
+      if (!window)
+        break;
+
+      if (window->visible)
+      {
+        // swallow repeat events
+        event->type = ADL_EVENT_NONE;
+        break;
+      }
+      window->visible = true;
+      windowPublishState(window);
+      break;
+
+    case ADL_EVENT_HIDE:
+      if (!window)
+        break;
+
+      if (!window->visible)
+      {
+        // swallow repeat events
+        event->type = ADL_EVENT_NONE;
+        break;
+      }
+      window->visible = false;
+      windowPublishState(window);
+      break;
+
+    case ADL_EVENT_FOCUS_IN:
+    case ADL_EVENT_FOCUS_OUT:
+      if (!window)
+        break;
+
+      if (window->focused == (event->type == ADL_EVENT_FOCUS_IN))
+      {
+        // swallow repeat events
+        event->type = ADL_EVENT_NONE;
+        break;
+      }
+      window->focused = event->type == ADL_EVENT_FOCUS_IN;
+      windowPublishState(window);
+      break;
+
+    case ADL_EVENT_MOUSE_MOVE :
+    case ADL_EVENT_MOUSE_DOWN :
+    case ADL_EVENT_MOUSE_UP   :
+    case ADL_EVENT_MOUSE_ENTER:
+    case ADL_EVENT_MOUSE_LEAVE:
+      if (!window)
+        break;
+
+      // the wheel "buttons" are never held
+      ADL_WINDOW_GET_ITEM(window)->buttons = event->u.mouse.buttons &
+        ~(ADL_MOUSE_BUTTON_WUP   | ADL_MOUSE_BUTTON_WDOWN |
+          ADL_MOUSE_BUTTON_WLEFT | ADL_MOUSE_BUTTON_WRIGHT);
+
+      // fill in the relX and relY fields
+      if (!window->haveMousePos)
+      {
+        window->haveMousePos = true;
+        window->mouseX       = event->u.mouse.x;
+        window->mouseY       = event->u.mouse.y;
+        event->u.mouse.relX  = 0;
+        event->u.mouse.relY  = 0;
+        windowPublishState(window);
+        break;
+      }
+
+      event->u.mouse.relX = event->u.mouse.x - window->mouseX;
+      event->u.mouse.relY = event->u.mouse.y - window->mouseY;
+
+      // if the mouse was warped null it out
+      if (event->u.mouse.warp)
+      {
+        event->u.mouse.relX -= event->u.mouse.warpX;
+        event->u.mouse.relY -= event->u.mouse.warpY;
+      }
+
+      // if there has been no change, swallow the event
+      if (event->type == ADL_EVENT_MOUSE_MOVE &&
+          event->u.mouse.relX    == 0 &&
+          event->u.mouse.relY    == 0 &&
+          event->u.mouse.x       == window->mouseX &&
+          event->u.mouse.y       == window->mouseY &&
+          event->u.mouse.warping == window->mouseWarping &&
+          event->u.mouse.warp    == window->mouseWarp)
+        event->type = ADL_EVENT_NONE;
+
+      window->mouseX       = event->u.mouse.x;
+      window->mouseY       = event->u.mouse.y;
+      window->mouseWarping = event->u.mouse.warping;
+      window->mouseWarp    = event->u.mouse.warp;
+      if (event->type != ADL_EVENT_NONE)
+        windowPublishState(window);
+      break;
+
+    case ADL_EVENT_WINDOW_CHANGE:
+      if (!window)
+        break;
+
+      if (!(window->x != event->u.win.x ||
+            window->y != event->u.win.y ||
+            window->w != event->u.win.w ||
+            window->h != event->u.win.h))
+      {
+        event->type = ADL_EVENT_NONE;
+        break;
+      }
+
+      window->x = event->u.win.x;
+      window->y = event->u.win.y;
+      window->w = event->u.win.w;
+      window->h = event->u.win.h;
+      windowPublishState(window);
+      break;
+
+    default:
+      break;
+  }
+
+}
+
+bool eventQueuePop(ADLEvent * event)
+{
+  queueLock();
+  if (!queue.count)
+  {
+    queueUnlock();
+    return false;
+  }
+
+  *event     = queue.events[queue.head];
+  queue.head = (queue.head + 1) % ADL_EVENT_QUEUE_SIZE;
+  --queue.count;
+  queueUnlock();
+  return true;
+}
+
+/* returns true if the event should be removed */
+typedef bool (*QueueFilterFn)(const ADLEvent * event, const void * udata);
+
+/* remove the events matching the filter, keeping the rest in order, the
+ * caller must hold the queue lock */
+static unsigned int queueRemove(QueueFilterFn filter, const void * udata)
+{
+  unsigned int kept = 0;
+  for(unsigned int i = 0; i < queue.count; ++i)
+  {
+    const ADLEvent * e = QUEUE_AT(i);
+    if (filter(e, udata))
+      continue;
+
+    if (kept != i)
+      *QUEUE_AT(kept) = *e;
+    ++kept;
+  }
+
+  const unsigned int removed = queue.count - kept;
+  queue.count = kept;
+  return removed;
+}
+
+/* a NULL window matches every event */
+static bool filterWindow(const ADLEvent * event, const void * udata)
+{
+  return !udata || event->window == udata;
+}
+
+static bool filterTypes(const ADLEvent * event, const void * udata)
+{
+  const ADLEventMask * types = udata;
+  return *types & ADL_EVENT_MASK(event->type);
+}
+
+static bool filterTimer(const ADLEvent * event, const void * udata)
+{
+  return event->type == ADL_EVENT_TIMER && event->u.timer.timer == udata;
+}
+
+void eventQueueClear(ADLWindow * window)
+{
+  queueLock();
+  queueRemove(filterWindow, window);
+  queueUnlock();
+}
+
+void eventQueueClearTimer(ADLTimer * timer)
+{
+  queueLock();
+  queueRemove(filterTimer, timer);
+  queueUnlock();
+}
+
+/* append the event, it is dropped if the queue is full */
+static void queuePush(const ADLEvent * event)
+{
+  queueLock();
+  if (queue.count < ADL_EVENT_QUEUE_SIZE)
+    *QUEUE_AT(queue.count++) = *event;
+  queueUnlock();
+}
+
+static bool queueFull(void)
+{
+  queueLock();
+  const bool full = queue.count == ADL_EVENT_QUEUE_SIZE;
+  queueUnlock();
+  return full;
+}
+
+/* move all pending platform and timer events into the queue until it is
+ * full */
+static ADL_STATUS queuePump(void)
+{
+  ADL_TRACE_SCOPE("eventPump");
+  ADL_STATUS status;
+  while(!queueFull())
+  {
+    ADLEvent event = { 0 };
+
+    ADL_AUDIT_EVENT(true);
+    status = adl.platform->processEvent(0, &event);
+    ADL_AUDIT_EVENT(false);
+
+    /* the platform returns ADL_EVENT_NONE once it has no more events */
+    const bool more = status == ADL_OK && event.type != ADL_EVENT_NONE;
+    if (more)
+    {
+      eventTranslate(&event);
+      if (event.type != ADL_EVENT_NONE)
+        queuePush(&event);
+    }
+
+    /* the platform returns with the event's window locked, it is queued
+     * before unlocking so windowFree is sure to clear it */
+    if (event.window)
+      windowUnlock(event.window);
+
+    if (status != ADL_OK)
+      return status;
+
+    if (!more)
+      break;
+  }
+
+  ADLEvent event;
+  while(!queueFull() && timerPollEvent(&event))
+    queuePush(&event);
+
+  return ADL_OK;
+}
+
+ADL_STATUS adlPeekEvents(ADLEventMask types, ADLEvent * out, unsigned int max,
+    unsigned int * count)
+{
+  ADL_INITCHECK;
+  ADL_NOT_NULL_CHECK(count);
+
+  ADL_STATUS status;
+  if ((status = queuePump()) != ADL_OK)
+    return status;
+
+  queueLock();
+  unsigned int found = 0;
+  for(unsigned int i = 0; i < queue.count; ++i)
+  {
+    const ADLEvent * e = QUEUE_AT(i);
+    if (!(types & ADL_EVENT_MASK(e->type)))
+      continue;
+
+    if (out)
+    {
+      if (found == max)
+        break;
+      out[found] = *e;
+    }
+    ++found;
+  }
+  queueUnlock();
+
+  *count = found;
+  return ADL_OK;
+}
+
+ADL_STATUS adlFlushEvents(ADLEventMask types)
+{
+  ADL_INITCHECK;
+
+  ADL_STATUS status;
+  if ((status = queuePump()) != ADL_OK)
+    return status;
+
+  queueLock();
+  queueRemove(filterTypes, &types);
+  queueUnlock();
+  return ADL_OK;
+}
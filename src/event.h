@@ -0,0 +1,49 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_EVENT
+#define _H_SRC_EVENT
+
+#include "adl/adl.h"
+
+#include <stdbool.h>
+
+/* capacity of the translated event ring */
+#define ADL_EVENT_QUEUE_SIZE 256
+
+/* update the window state from the event and fill in the derived fields, the
+ * type is set to ADL_EVENT_NONE if the event should be swallowed */
+void eventTranslate(ADLEvent * event);
+
+/* pop the oldest queued event, returns false if the queue is empty */
+bool eventQueuePop(ADLEvent * event);
+
+/* drop all queued events, or only those for `window` if not NULL */
+void eventQueueClear(ADLWindow * window);
+
+/* drop the queued events of a timer that is being destroyed */
+void eventQueueClearTimer(ADLTimer * timer);
+
+#endif
@@ -0,0 +1,44 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_FUTEX
+#define _H_SRC_FUTEX
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* no deadline for futexWait */
+#define FUTEX_FOREVER UINT64_MAX
+
+/* sleep while `*addr == expected` until woken or `deadlineNS` in adlGetClockNS
+ * time, returns false only if the deadline passed. Spurious wakeups are
+ * possible so callers must recheck their condition */
+bool futexWait(atomic_uint * addr, unsigned int expected, uint64_t deadlineNS);
+
+/* wake one or all of the threads waiting on `addr` */
+void futexWake(atomic_uint * addr, bool all);
+
+#endif
@@ -0,0 +1,299 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "handle.h"
+#include "adl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+
+#define HANDLE_NONE UINT32_MAX
+
+static inline uint32_t hashId(uint64_t id)
+{
+  id ^= id >> 33;
+  id *= 0xff51afd7ed558ccdULL;
+  id ^= id >> 33;
+  return (uint32_t)id;
+}
+
+void adlHandleTableNew(ADLHandleTable * table)
+{
+  assert(table);
+  memset(table, 0, sizeof(*table));
+  table->freeSlot = HANDLE_NONE;
+}
+
+void adlHandleTableFree(ADLHandleTable * table)
+{
+  assert(table);
+
+  if (table->count)
+    ADL_BUG(ADL_ERR_BUSY, "freeing a handle table with %u items",
+        table->count);
+
+  free(table->slots);
+  free(table->items);
+  free(table->itemSlot);
+  free(table->map);
+  adlHandleTableNew(table);
+}
+
+static ADL_STATUS growSlots(ADLHandleTable * table)
+{
+  const uint32_t size = table->slotSize ? table->slotSize * 2 : 8;
+
+  ADLHandleSlot * slots    = realloc(table->slots   , size * sizeof(*slots   ));
+  if (slots)
+    table->slots = slots;
+
+  void         ** items    = realloc(table->items   , size * sizeof(*items   ));
+  if (items)
+    table->items = items;
+
+  uint32_t      * itemSlot = realloc(table->itemSlot, size * sizeof(*itemSlot));
+  if (itemSlot)
+    table->itemSlot = itemSlot;
+
+  if (!slots || !items || !itemSlot)
+  {
+    ADL_ERROR(ADL_ERR_NO_MEM, "failed to grow the handle table");
+    return ADL_ERR_NO_MEM;
+  }
+
+  table->slotSize = size;
+  return ADL_OK;
+}
+
+/* returns true if the id was not already in the map */
+static bool mapInsert(ADLHandleMapEntry * map, uint32_t mapSize, uint64_t id,
+    uint32_t slot)
+{
+  const uint32_t mask = mapSize - 1;
+  uint32_t i = hashId(id) & mask;
+  while(map[i].slot != HANDLE_NONE && map[i].id != id)
+    i = (i + 1) & mask;
+
+  const bool added = map[i].slot == HANDLE_NONE;
+  map[i].id   = id;
+  map[i].slot = slot;
+  return added;
+}
+
+static ADL_STATUS growMap(ADLHandleTable * table)
+{
+  const uint32_t size = table->mapSize ? table->mapSize * 2 : 16;
+  ADLHandleMapEntry * map = malloc(size * sizeof(*map));
+  if (!map)
+  {
+    ADL_ERROR(ADL_ERR_NO_MEM, "failed to grow the handle map");
+    return ADL_ERR_NO_MEM;
+  }
+
+  for(uint32_t i = 0; i < size; ++i)
+    map[i].slot = HANDLE_NONE;
+
+  for(uint32_t i = 0; i < table->mapSize; ++i)
+    if (table->map[i].slot != HANDLE_NONE)
+      mapInsert(map, size, table->map[i].id, table->map[i].slot);
+
+  free(table->map);
+  table->map     = map;
+  table->mapSize = size;
+  return ADL_OK;
+}
+
+static void mapRemove(ADLHandleTable * table, uint64_t id)
+{
+  const uint32_t mask = table->mapSize - 1;
+  uint32_t i = hashId(id) & mask;
+  while(table->map[i].id != id)
+  {
+    if (table->map[i].slot == HANDLE_NONE)
+      return;
+    i = (i + 1) & mask;
+  }
+
+  /* shift back any following entries that would no longer be reachable */
+  for(uint32_t j = i;;)
+  {
+    j = (j + 1) & mask;
+    if (table->map[j].slot == HANDLE_NONE)
+      break;
+
+    const uint32_t k = hashId(table->map[j].id) & mask;
+    if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+      continue;
+
+    table->map[i] = table->map[j];
+    i = j;
+  }
+
+  table->map[i].slot = HANDLE_NONE;
+  --table->mapUsed;
+}
+
+ADL_STATUS adlHandleAdd(ADLHandleTable * table, void * item,
+    ADLHandle * result)
+{
+  assert(table);
+  assert(item);
+  assert(result);
+
+  ADL_STATUS status;
+  uint32_t   index = table->freeSlot;
+  if (index != HANDLE_NONE)
+    table->freeSlot = table->slots[index].link;
+  else
+  {
+    if (table->slotCount == table->slotSize &&
+        (status = growSlots(table)) != ADL_OK)
+      return status;
+
+    index = table->slotCount++;
+    table->slots[index].generation = 1;
+  }
+
+  ADLHandleSlot * slot = &table->slots[index];
+  slot->item = item;
+  slot->id   = 0;
+  slot->link = table->count;
+
+  table->items   [table->count] = item;
+  table->itemSlot[table->count] = index;
+  ++table->count;
+
+  *result = ((uint64_t)slot->generation << 32) | index;
+  return ADL_OK;
+}
+
+void adlHandleRemove(ADLHandleTable * table, ADLHandle handle)
+{
+  assert(table);
+
+  const uint32_t index = ADL_HANDLE_INDEX(handle);
+  if (!adlHandleGet(table, handle))
+  {
+    ADL_BUG(ADL_ERR_INVALID_ARGUMENT, "stale handle %u:%u",
+        index, ADL_HANDLE_GENERATION(handle));
+    return;
+  }
+
+  ADLHandleSlot * slot = &table->slots[index];
+  if (slot->id)
+    mapRemove(table, slot->id);
+
+  /* move the last item into the hole to keep the items packed */
+  const uint32_t last = --table->count;
+  if (slot->link != last)
+  {
+    table->items   [slot->link] = table->items   [last];
+    table->itemSlot[slot->link] = table->itemSlot[last];
+    table->slots[table->itemSlot[last]].link = slot->link;
+  }
+
+  slot->item = NULL;
+  slot->id   = 0;
+  ++slot->generation;
+  slot->link      = table->freeSlot;
+  table->freeSlot = index;
+}
+
+void * adlHandleGet(const ADLHandleTable * table, ADLHandle handle)
+{
+  assert(table);
+
+  const uint32_t index = ADL_HANDLE_INDEX(handle);
+  if (index >= table->slotCount)
+    return NULL;
+
+  const ADLHandleSlot * slot = &table->slots[index];
+  if (slot->generation != ADL_HANDLE_GENERATION(handle))
+    return NULL;
+
+  return slot->item;
+}
+
+bool adlHandleContains(const ADLHandleTable * table, const void * item)
+{
+  assert(table);
+
+  for(uint32_t i = 0; i < table->count; ++i)
+    if (table->items[i] == item)
+      return true;
+
+  return false;
+}
+
+ADL_STATUS adlHandleSetId(ADLHandleTable * table, ADLHandle handle,
+    uint64_t id)
+{
+  assert(table);
+
+  if (!id || !adlHandleGet(table, handle))
+  {
+    ADL_BUG(ADL_ERR_INVALID_ARGUMENT, "invalid handle or id");
+    return ADL_ERR_INVALID_ARGUMENT;
+  }
+
+  ADLHandleSlot * slot = &table->slots[ADL_HANDLE_INDEX(handle)];
+  if (slot->id)
+    mapRemove(table, slot->id);
+
+  /* keep the load factor at or below one half */
+  ADL_STATUS status;
+  if ((table->mapUsed + 1) * 2 > table->mapSize &&
+      (status = growMap(table)) != ADL_OK)
+    return status;
+
+  if (mapInsert(table->map, table->mapSize, id, ADL_HANDLE_INDEX(handle)))
+    ++table->mapUsed;
+  else
+    ADL_BUG(ADL_ERR_INVALID_ARGUMENT, "duplicate id %" PRIu64, id);
+  slot->id = id;
+
+  return ADL_OK;
+}
+
+void * adlHandleFind(const ADLHandleTable * table, uint64_t id)
+{
+  assert(table);
+
+  if (!table->mapUsed)
+    return NULL;
+
+  const uint32_t mask = table->mapSize - 1;
+  for(uint32_t i = hashId(id) & mask;; i = (i + 1) & mask)
+  {
+    const ADLHandleMapEntry * e = &table->map[i];
+    if (e->slot == HANDLE_NONE)
+      return NULL;
+
+    if (e->id == id)
+      return table->slots[e->slot].item;
+  }
+}
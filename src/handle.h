@@ -0,0 +1,97 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_HANDLE
+#define _H_SRC_HANDLE
+
+#include "adl/status.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* slot index in the low 32 bits, slot generation in the high 32 bits */
+typedef uint64_t ADLHandle;
+
+#define ADL_HANDLE_INDEX(h)      ((uint32_t)(h))
+#define ADL_HANDLE_GENERATION(h) ((uint32_t)((h) >> 32))
+
+typedef struct
+{
+  void   * item;
+  uint64_t id;
+  uint32_t generation;
+  uint32_t link;  // index into `items` while in use, next free slot otherwise
+}
+ADLHandleSlot;
+
+typedef struct
+{
+  uint64_t id;
+  uint32_t slot;
+}
+ADLHandleMapEntry;
+
+/* generational slot map, live items are kept packed in `items[0..count)` for
+ * iteration and can be looked up by their platform id */
+typedef struct
+{
+  ADLHandleSlot * slots;
+  uint32_t        slotCount;
+  uint32_t        slotSize;
+  uint32_t        freeSlot;
+
+  void    ** items;
+  uint32_t * itemSlot;
+  uint32_t   count;
+
+  ADLHandleMapEntry * map;
+  uint32_t            mapSize;
+  uint32_t            mapUsed;
+}
+ADLHandleTable;
+
+void adlHandleTableNew (ADLHandleTable * table);
+void adlHandleTableFree(ADLHandleTable * table);
+
+ADL_STATUS adlHandleAdd(ADLHandleTable * table, void * item,
+    ADLHandle * result);
+
+/* remove the item, the handle and any item moved into it's place in `items`
+ * stay valid */
+void adlHandleRemove(ADLHandleTable * table, ADLHandle handle);
+
+/* returns NULL if the handle is stale */
+void * adlHandleGet(const ADLHandleTable * table, ADLHandle handle);
+
+/* returns true if the item is live in the table, a linear scan by pointer
+ * that never dereferences `item` so it is safe on freed memory */
+bool adlHandleContains(const ADLHandleTable * table, const void * item);
+
+/* associate a non-zero platform id with the handle for adlHandleFind */
+ADL_STATUS adlHandleSetId(ADLHandleTable * table, ADLHandle handle,
+    uint64_t id);
+void * adlHandleFind(const ADLHandleTable * table, uint64_t id);
+
+#endif
@@ -25,31 +25,84 @@
 #include "image.h"
 #include "adl.h"
 #include "window.h"
+#include "convert.h"
 
 #include <stdlib.h>
 
-void imageListItemDestructor(ADLLinkedListItem  * item)
+void imageFree(ADLImageItem * item)
 {
-  ADLImageListItem * ii = (ADLImageListItem*)item;
-
   ADL_STATUS status;
-  if ((status = adl.platform->imageDestroy(&ii->image)) != ADL_OK)
+  if ((status = adl.platform->imageDestroy(&item->image)) != ADL_OK)
     ADL_ERROR(status, "imageDestroy failed");
 
-  free(ii);
+  adlDiffFree(&item->diff);
+  adlHandleRemove(ADL_GET_WINDOW_IMAGES(item->image.window), item->handle);
+
+  adlSlabLock();
+  adlSlabRelease(&adl.imageSlab, item);
+  adlSlabUnlock();
+}
+
+bool imageIsValid(ADLImage * image)
+{
+  /* the image may have been freed so image->window can not be trusted,
+   * search every window's images without reading it */
+  const ADLImageItem * item  = ADL_IMAGE_GET_ITEM(image);
+  bool                 valid = false;
+
+  adlWindowsLock(false);
+  for(uint32_t i = 0; i < adl.windows.count && !valid; ++i)
+  {
+    ADLWindowItem * win = adl.windows.items[i];
+    windowLock(&win->window);
+    valid = adlHandleContains(&win->images, item);
+    windowUnlock(&win->window);
+  }
+  adlWindowsUnlock();
+
+  return valid;
 }
 
 ADLImage * imageFindById(ADLWindow * window, ADLImageId id)
 {
-  ADLLinkedListItem * item;
-  for(item = ADL_GET_WINDOW_IMAGE_LIST(window)->head;
-      item != NULL; item = item->next)
+  ADLImageItem * item = adlHandleFind(ADL_GET_WINDOW_IMAGES(window), id);
+  return item ? &item->image : NULL;
+}
+
+/* returns the bytes per pixel of packed formats, or zero if not packed */
+static unsigned int imageBytesPerPixel(const ADLImageDef * def)
+{
+  switch(def->format)
   {
-    ADLImageListItem * li = (ADLImageListItem *)item;
-    if (ADL_GET_IMAGE_ID(&li->image) == id)
-      return &li->image;
+    case ADL_IMAGE_FORMAT_RGBA:
+    case ADL_IMAGE_FORMAT_BGRA:
+      return def->depth / 8;
+
+    case ADL_IMAGE_FORMAT_RGB565     : return 2;
+    case ADL_IMAGE_FORMAT_XRGB2101010: return 4;
+
+    default:
+      return 0;
   }
-  return NULL;
+}
+
+/* returns the size of the storage of a buffer image */
+static size_t imageBufferSize(const ADLImageDef * def)
+{
+  if (!adlConvertIsYUV(def->format))
+    return (size_t)def->pitch * def->h;
+
+  const unsigned int planes = def->format == ADL_IMAGE_FORMAT_NV12 ? 2 : 3;
+  size_t size = 0;
+  for(unsigned int i = 0; i < planes; ++i)
+  {
+    const unsigned int rows = i == 0 ? def->h : (def->h + 1) / 2;
+    const size_t       end  = def->planes[i].offset +
+      (size_t)def->planes[i].pitch * rows;
+    if (end > size)
+      size = end;
+  }
+  return size;
 }
 
 /* get the backends supported by the platform */
@@ -67,29 +120,88 @@ ADL_STATUS adlImageCreate(ADLWindow * window, const ADLImageDef def,
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
   ADL_NOT_NULL_CHECK(result);
+  ADL_WINDOW_CHECK(window);
 
   ADL_STATUS status;
 
   *result = NULL;
-  ADLImageListItem * item;
-  status = adlLinkedListNewItem(ADL_GET_WINDOW_IMAGE_LIST(window),
-      (ADLLinkedListItem **)&item);
+
+  const unsigned int bpp = imageBytesPerPixel(&def);
+  if ((def.flags & ADL_IMAGE_FLAG_DIFF) &&
+      (def.backend != ADL_IMAGE_BACKEND_BUFFER || !bpp))
+  {
+    ADL_ERROR(ADL_ERR_UNSUPPORTED_FORMAT,
+        "ADL_IMAGE_FLAG_DIFF requires a packed format buffer image");
+    return ADL_ERR_UNSUPPORTED_FORMAT;
+  }
+
+  ADLHandleTable * images = ADL_GET_WINDOW_IMAGES(window);
+  ADLImageItem   * item;
+  adlSlabLock();
+  status = adlSlabAlloc(&adl.imageSlab, (void **)&item);
+  adlSlabUnlock();
+  if (status != ADL_OK)
+    return status;
+
+  windowLock(window);
+  status = adlHandleAdd(images, item, &item->handle);
   if (status != ADL_OK)
+  {
+    windowUnlock(window);
+    adlSlabLock();
+    adlSlabRelease(&adl.imageSlab, item);
+    adlSlabUnlock();
     return status;
+  }
 
   ADLImage * img = &item->image;
   img->window = window;
+  img->w      = def.w;
+  img->h      = def.h;
 
-  status = adl.platform->imageCreate(window, def, img);
-  if (status == ADL_OK && !item->id)
+  {
+    ADL_TRACE_SCOPE("imageCreate");
+    status = adl.platform->imageCreate(window, def, img);
+  }
+  if (status != ADL_OK)
+    goto err_remove;
+
+  if (!item->id)
   {
     ADL_BUG(ADL_ERR_PLATFORM,
         "%s->imageCreate did not set the image id", adl.platform->name);
-    adlLinkedListPop(&adl.windowList, NULL);
-    return ADL_ERR_PLATFORM;
+    status = ADL_ERR_PLATFORM;
+    goto err_destroy;
+  }
+
+  status = adlHandleSetId(images, item->handle, item->id);
+  if (status != ADL_OK)
+    goto err_destroy;
+
+  if (def.backend == ADL_IMAGE_BACKEND_BUFFER)
+    item->bufferSize = imageBufferSize(&def);
+
+  if (def.flags & ADL_IMAGE_FLAG_DIFF)
+  {
+    item->buffer = def.u.buffer;
+    status = adlDiffNew(def.w, def.h, def.pitch, bpp, def.u.buffer,
+        &item->diff);
+    if (status != ADL_OK)
+      goto err_destroy;
   }
 
+  windowUnlock(window);
   *result = img;
+  return ADL_OK;
+
+err_destroy:
+  adl.platform->imageDestroy(img);
+err_remove:
+  adlHandleRemove(images, item->handle);
+  windowUnlock(window);
+  adlSlabLock();
+  adlSlabRelease(&adl.imageSlab, item);
+  adlSlabUnlock();
   return status;
 }
 
@@ -102,14 +214,51 @@ ADL_STATUS adlImageDestroy(ADLImage ** image)
   if (!*image)
     return ADL_OK;
 
-  ADL_STATUS status = ADL_OK;
+  ADL_IMAGE_CHECK(*image);
 
-  ADLLinkedList    * ll = ADL_GET_IMAGE_LIST(*image);
-  ADLImageListItem * li = ADL_IMAGE_GET_LIST_ITEM(*image);
-  adlLinkedListRemove(ll, (ADLLinkedListItem **)&li, true);
+  /* the upload thread takes the window lock, finish with it first */
+  adlUploadCancel(*image);
+
+  ADLWindow * window = (*image)->window;
+  windowLock(window);
+  imageFree(ADL_IMAGE_GET_ITEM(*image));
+  windowUnlock(window);
 
   *image = NULL;
-  return status;
+  return ADL_OK;
+}
+
+ADL_STATUS imageUpdate(ADLImage * image, const void * buffer)
+{
+  ADL_TRACE_SCOPE("imageUpdate");
+
+  ADLImageItem * li = ADL_IMAGE_GET_ITEM(image);
+  if (!li->diff)
+    return buffer ?
+      adl.platform->imageUpdateRects(image, buffer, NULL, 0) :
+      adl.platform->imageUpdate(image);
+
+  const ADLRect * rects;
+  const unsigned int count = adlDiffUpdate(li->diff,
+      buffer ? buffer : li->buffer, &rects);
+
+  ADLImageStats * stats = &li->stats;
+  ++stats->updates;
+  stats->tiles      += li->diff->tilesX * li->diff->tilesY;
+  stats->dirtyTiles += li->diff->dirtyTiles;
+  stats->bytesTotal += (uint64_t)image->w * image->h * li->diff->bpp;
+
+  if (!count)
+  {
+    ++stats->skipped;
+    return ADL_OK;
+  }
+
+  for(unsigned int i = 0; i < count; ++i)
+    stats->bytesUploaded +=
+      (uint64_t)rects[i].w * rects[i].h * li->diff->bpp;
+
+  return adl.platform->imageUpdateRects(image, buffer, rects, count);
 }
 
 /* update the image from it's backend storage */
@@ -117,5 +266,93 @@ ADL_STATUS adlImageUpdate(ADLImage * image)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(image);
-  return adl.platform->imageUpdate(image);
+  ADL_IMAGE_CHECK(image);
+
+  windowLock(image->window);
+  const ADL_STATUS status = imageUpdate(image, NULL);
+  windowUnlock(image->window);
+  return status;
+}
+
+/* queue a buffer for upload and presentation by the upload thread */
+ADL_STATUS adlImageSubmit(ADLImage * image, const void * buffer,
+    ADLImageSubmitFn fn, void * udata)
+{
+  ADL_INITCHECK;
+  ADL_NOT_NULL_CHECK(image);
+  ADL_IMAGE_CHECK(image);
+  ADL_NOT_NULL_CHECK(buffer);
+
+  /* the upload thread calls into the platform which is only serialized with
+   * the application's threads in thread-safe mode */
+  if (!adl.threadSafe)
+  {
+    ADL_ERROR(ADL_ERR_UNSUPPORTED,
+        "adlImageSubmit requires adlSetThreadSafe(true)");
+    return ADL_ERR_UNSUPPORTED;
+  }
+
+  if (!ADL_IMAGE_GET_ITEM(image)->bufferSize)
+  {
+    ADL_ERROR(ADL_ERR_UNSUPPORTED_BACKEND,
+        "adlImageSubmit requires a buffer image");
+    return ADL_ERR_UNSUPPORTED_BACKEND;
+  }
+
+  return adlUploadSubmit(image, buffer, fn, udata);
+}
+
+/* update and present the `src` rectangle of the image at x,y in the window */
+ADL_STATUS adlImagePresentAt(ADLImage * image, int x, int y,
+    const ADLRect * src)
+{
+  ADL_INITCHECK;
+  ADL_NOT_NULL_CHECK(image);
+  ADL_IMAGE_CHECK(image);
+  ADL_TRACE_SCOPE("imagePresentAt");
+
+  ADLRect rect = { .w = image->w, .h = image->h };
+  if (src)
+  {
+    /* clip the source to the image */
+    const int x2 = src->x + src->w < (int)image->w ?
+      src->x + src->w : (int)image->w;
+    const int y2 = src->y + src->h < (int)image->h ?
+      src->y + src->h : (int)image->h;
+
+    rect.x = src->x > 0 ? src->x : 0;
+    rect.y = src->y > 0 ? src->y : 0;
+    rect.w = x2 - rect.x;
+    rect.h = y2 - rect.y;
+
+    /* keep the destination in step with the clipped source */
+    x += rect.x - src->x;
+    y += rect.y - src->y;
+  }
+
+  if (rect.w <= 0 || rect.h <= 0)
+    return ADL_OK;
+
+  windowLock(image->window);
+  const ADL_STATUS status = adl.platform->imagePresentAt(image, x, y, &rect);
+  windowUnlock(image->window);
+  return status;
+}
+
+/* get the statistics of an image created with ADL_IMAGE_FLAG_DIFF */
+ADL_STATUS adlImageGetStats(ADLImage * image, ADLImageStats * stats)
+{
+  ADL_INITCHECK;
+  ADL_NOT_NULL_CHECK(image);
+  ADL_IMAGE_CHECK(image);
+  ADL_NOT_NULL_CHECK(stats);
+
+  ADLImageItem * li = ADL_IMAGE_GET_ITEM(image);
+  if (!li->diff)
+    return ADL_ERR_UNSUPPORTED;
+
+  windowLock(image->window);
+  *stats = li->stats;
+  windowUnlock(image->window);
+  return ADL_OK;
 }
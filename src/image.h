@@ -26,37 +26,60 @@
 #define _H_SRC_IMAGE
 
 #include "adl.h"
-#include "linkedlist.h"
+#include "handle.h"
+#include "diff.h"
+#include "upload.h"
 #include "adl/image.h"
 #include <stdint.h>
 
 typedef uint64_t ADLImageId;
 typedef struct
 {
-  ADLLinkedListItem item;
+  ADLImageId    id;
+  ADLHandle     handle;
+  ADLImage      image;
 
-  ADLImageId   id;
-  ADLImage     image;
+  // ADL_IMAGE_FLAG_DIFF state
+  ADLImageBuffer buffer;
+  ADLDiff      * diff;
+  ADLImageStats  stats;
+
+  // adlImageSubmit state
+  size_t      bufferSize;
+  ADLUpload * upload;
 }
-ADLImageListItem;
+ADLImageItem;
 
-#define ADL_IMAGE_GET_LIST_ITEM(x) \
-  ((ADLImageListItem *)(((uint8_t*)ADL_CHECK_TYPE(ADLImage *, x)) - \
-     offsetof(ADLImageListItem, image)))
+#define ADL_IMAGE_GET_ITEM(x) \
+  ((ADLImageItem *)(((uint8_t*)ADL_CHECK_TYPE(ADLImage *, x)) - \
+     offsetof(ADLImageItem, image)))
 
 #define ADL_SET_IMAGE_ID(x, v) \
-  ADL_IMAGE_GET_LIST_ITEM(x)->id = v
+  ADL_IMAGE_GET_ITEM(x)->id = v
 
 #define ADL_GET_IMAGE_ID(x) \
-  ADL_IMAGE_GET_LIST_ITEM(x)->id
+  ADL_IMAGE_GET_ITEM(x)->id
 
 #define ADL_GET_IMAGE_DATA(x) \
-  ((void *)(ADL_IMAGE_GET_LIST_ITEM(x)+1))
+  ((void *)(ADL_IMAGE_GET_ITEM(x)+1))
 
-#define ADL_GET_IMAGE_LIST(x) \
-  ADL_GET_WINDOW_IMAGE_LIST((x)->window)
+/* debug builds reject images that have already been destroyed */
+#ifndef NDEBUG
+#define ADL_IMAGE_CHECK(x) \
+  if (!imageIsValid(x)) \
+  { \
+    ADL_BUG(ADL_ERR_INVALID_ARGUMENT, #x " is not a valid image"); \
+    return ADL_ERR_INVALID_ARGUMENT; \
+  }
+#else
+#define ADL_IMAGE_CHECK(x)
+#endif
 
-void imageListItemDestructor(ADLLinkedListItem * item);
+void imageFree(ADLImageItem * item);
+bool imageIsValid(ADLImage * image);
 ADLImage * imageFindById(ADLWindow * window, ADLImageId id);
 
+/* update the image from `buffer`, or it's own storage if NULL */
+ADL_STATUS imageUpdate(ADLImage * image, const void * buffer);
+
 #endif
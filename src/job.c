@@ -0,0 +1,537 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "adl/job.h"
+#include "adl/thread.h"
+#include "adl/logging.h"
+#include "adl/util.h"
+
+#include <stdlib.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* must be a power of two, a push to a full deque runs the job inline */
+#define JOB_DEQUE_SIZE 1024
+
+/* fruitless searches before an idle thread goes to sleep */
+#define JOB_SPIN 256
+
+typedef struct Job
+{
+  ADLJobFn        fn;
+  ADLJobRangeFn   rangeFn;
+  void          * udata;
+  unsigned int    start, end, grain;
+  ADLJobCounter * counter;
+  struct Job    * next;
+}
+Job;
+
+/* Chase-Lev work stealing deque, the owner pushes and takes at the bottom and
+ * thieves steal from the top */
+typedef struct
+{
+  alignas(64) atomic_int_fast64_t top;
+  alignas(64) atomic_int_fast64_t bottom;
+  _Atomic(Job *) slots[JOB_DEQUE_SIZE];
+}
+Deque;
+
+typedef struct
+{
+  Deque          deque;
+  ADLJobSystem * js;
+  uint32_t       seed;
+  bool           started;
+  ADLThread      thread;
+}
+Worker;
+
+struct ADLJobSystem
+{
+  unsigned int workers;
+  Worker     * worker;
+
+  /* protects the shared queue of jobs submitted from other threads and is
+   * held to sleep */
+  pthread_mutex_t lock;
+  pthread_cond_t  work;
+  pthread_cond_t  done;
+  Job           * head;
+  Job           * tail;
+
+  /* jobs in the deques and shared queue, briefly negative while a job is taken
+   * before its push has been counted */
+  atomic_int  queued;
+  atomic_uint sleepers;
+  atomic_uint waiters;
+};
+
+static _Thread_local Worker * self = NULL;
+
+static bool dequePush(Deque * d, Job * job)
+{
+  const int_fast64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  const int_fast64_t t = atomic_load_explicit(&d->top   , memory_order_acquire);
+  if (b - t >= JOB_DEQUE_SIZE)
+    return false;
+
+  atomic_store_explicit(&d->slots[b & (JOB_DEQUE_SIZE - 1)], job,
+      memory_order_relaxed);
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+  return true;
+}
+
+static Job * dequeTake(Deque * d)
+{
+  const int_fast64_t b =
+    atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int_fast64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+  if (t > b)
+  {
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return NULL;
+  }
+
+  Job * job = atomic_load_explicit(&d->slots[b & (JOB_DEQUE_SIZE - 1)],
+      memory_order_relaxed);
+  if (t == b)
+  {
+    /* the last job, race the thieves for it */
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+          memory_order_seq_cst, memory_order_relaxed))
+      job = NULL;
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  }
+  return job;
+}
+
+static Job * dequeSteal(Deque * d)
+{
+  int_fast64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  const int_fast64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+  if (t >= b)
+    return NULL;
+
+  Job * job = atomic_load_explicit(&d->slots[t & (JOB_DEQUE_SIZE - 1)],
+      memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+        memory_order_seq_cst, memory_order_relaxed))
+    return NULL;
+  return job;
+}
+
+static void jobWake(ADLJobSystem * js)
+{
+  if (!atomic_load(&js->sleepers) && !atomic_load(&js->waiters))
+    return;
+
+  pthread_mutex_lock(&js->lock);
+  pthread_cond_signal   (&js->work);
+  pthread_cond_broadcast(&js->done);
+  pthread_mutex_unlock(&js->lock);
+}
+
+/* returns false if the job could not be queued and must be run by the caller */
+static bool jobQueue(ADLJobSystem * js, Job * job)
+{
+  atomic_fetch_add(&js->queued, 1);
+  if (self && self->js == js)
+  {
+    if (!dequePush(&self->deque, job))
+    {
+      atomic_fetch_sub(&js->queued, 1);
+      return false;
+    }
+  }
+  else
+  {
+    job->next = NULL;
+    pthread_mutex_lock(&js->lock);
+    if (js->tail)
+      js->tail->next = job;
+    else
+      js->head = job;
+    js->tail = job;
+    pthread_mutex_unlock(&js->lock);
+  }
+
+  jobWake(js);
+  return true;
+}
+
+static Job * jobFind(ADLJobSystem * js, Worker * w)
+{
+  Job * job = NULL;
+
+  if (w && (job = dequeTake(&w->deque)))
+    goto found;
+
+  if (atomic_load_explicit(&js->queued, memory_order_relaxed) <= 0)
+    return NULL;
+
+  pthread_mutex_lock(&js->lock);
+  if ((job = js->head))
+  {
+    js->head = job->next;
+    if (!js->head)
+      js->tail = NULL;
+  }
+  pthread_mutex_unlock(&js->lock);
+  if (job)
+    goto found;
+
+  /* start at a random victim so thieves spread over the workers */
+  unsigned int victim = 0;
+  if (w)
+  {
+    w->seed ^= w->seed << 13;
+    w->seed ^= w->seed >> 17;
+    w->seed ^= w->seed << 5;
+    victim = w->seed % js->workers;
+  }
+
+  for(unsigned int i = 0; i < js->workers; ++i)
+  {
+    Worker * v = &js->worker[(victim + i) % js->workers];
+    if (v != w && (job = dequeSteal(&v->deque)))
+      goto found;
+  }
+  return NULL;
+
+found:
+  atomic_fetch_sub(&js->queued, 1);
+  return job;
+}
+
+static void jobComplete(ADLJobSystem * js, ADLJobCounter * counter)
+{
+  /* the counter may be released as soon as it reaches zero */
+  if (atomic_fetch_sub(&counter->pending, 1) != 1)
+    return;
+
+  if (atomic_load(&js->waiters))
+  {
+    pthread_mutex_lock(&js->lock);
+    pthread_cond_broadcast(&js->done);
+    pthread_mutex_unlock(&js->lock);
+  }
+}
+
+static void jobRun(ADLJobSystem * js, Job * job)
+{
+  if (job->rangeFn)
+  {
+    /* queue the upper half and keep splitting the lower half, the largest
+     * ranges are on top of the deque where thieves take them from */
+    while(job->end - job->start > job->grain)
+    {
+      Job * split = malloc(sizeof(*split));
+      if (!split)
+        break;
+
+      const unsigned int mid = job->start + (job->end - job->start) / 2;
+      *split       = *job;
+      split->start = mid;
+
+      atomic_fetch_add_explicit(&job->counter->pending, 1,
+          memory_order_relaxed);
+      if (!jobQueue(js, split))
+      {
+        atomic_fetch_sub_explicit(&job->counter->pending, 1,
+            memory_order_relaxed);
+        free(split);
+        break;
+      }
+      job->end = mid;
+    }
+    job->rangeFn(job->start, job->end, job->udata);
+  }
+  else
+    job->fn(job->udata);
+
+  ADLJobCounter * counter = job->counter;
+  free(job);
+
+  if (counter)
+    jobComplete(js, counter);
+}
+
+static void * workerThread(ADLThread * thread, void * udata)
+{
+  Worker       * w  = (Worker *)udata;
+  ADLJobSystem * js = w->js;
+  unsigned int idle = 0;
+
+  self = w;
+  while(adlThreadIsRunning(thread))
+  {
+    Job * job = jobFind(js, w);
+    if (job)
+    {
+      jobRun(js, job);
+      idle = 0;
+      continue;
+    }
+
+    if (++idle < JOB_SPIN)
+    {
+      adlCPURelax();
+      continue;
+    }
+
+    /* jobQueue counts the job before checking for sleepers and we register
+     * before checking the count, so one of us always sees the other */
+    idle = 0;
+    atomic_fetch_add(&js->sleepers, 1);
+    pthread_mutex_lock(&js->lock);
+    while(atomic_load(&js->queued) <= 0 && adlThreadIsRunning(thread))
+      pthread_cond_wait(&js->work, &js->lock);
+    pthread_mutex_unlock(&js->lock);
+    atomic_fetch_sub(&js->sleepers, 1);
+  }
+
+  self = NULL;
+  return NULL;
+}
+
+static void jobStop(ADLJobSystem * js)
+{
+  for(unsigned int i = 0; i < js->workers; ++i)
+    if (js->worker[i].started)
+      adlThreadStop(&js->worker[i].thread);
+
+  pthread_mutex_lock(&js->lock);
+  pthread_cond_broadcast(&js->work);
+  pthread_mutex_unlock(&js->lock);
+
+  for(unsigned int i = 0; i < js->workers; ++i)
+    if (js->worker[i].started)
+      adlThreadJoin(&js->worker[i].thread, NULL, -1);
+}
+
+ADL_STATUS adlJobSystemCreate(unsigned int workers, ADLJobSystem ** result)
+{
+  if (!result)
+    return ADL_ERR_INVALID_ARGUMENT;
+
+  if (!workers)
+    workers = adlGetCPUCount();
+
+  ADLJobSystem * js = calloc(1, sizeof(*js));
+  if (!js)
+    goto err_nomem;
+
+  js->workers = workers;
+  js->worker  = aligned_alloc(alignof(Worker), workers * sizeof(Worker));
+  if (!js->worker)
+    goto err_free;
+
+  pthread_mutex_init(&js->lock, NULL);
+  pthread_cond_init (&js->work, NULL);
+  pthread_cond_init (&js->done, NULL);
+
+  for(unsigned int i = 0; i < workers; ++i)
+  {
+    Worker * w = &js->worker[i];
+    atomic_init(&w->deque.top   , 0);
+    atomic_init(&w->deque.bottom, 0);
+    w->js      = js;
+    w->seed    = 0x9e3779b9u * (i + 1);
+    w->started = false;
+  }
+
+  const ADLThreadAttr attr = { .name = "adl-job" };
+  for(unsigned int i = 0; i < workers; ++i)
+  {
+    Worker * w = &js->worker[i];
+    if (adlThreadCreateEx(workerThread, w, &attr, &w->thread, NULL) != ADL_OK)
+    {
+      ADL_ERROR(ADL_ERR_PLATFORM, "failed to start job worker %u", i);
+      jobStop(js);
+      pthread_cond_destroy (&js->done);
+      pthread_cond_destroy (&js->work);
+      pthread_mutex_destroy(&js->lock);
+      free(js->worker);
+      free(js);
+      return ADL_ERR_PLATFORM;
+    }
+    w->started = true;
+  }
+
+  *result = js;
+  return ADL_OK;
+
+err_free:
+  free(js);
+err_nomem:
+  ADL_ERROR(ADL_ERR_NO_MEM, "failed to allocate the job system");
+  return ADL_ERR_NO_MEM;
+}
+
+void adlJobSystemDestroy(ADLJobSystem ** js)
+{
+  if (!js || !*js)
+    return;
+
+  jobStop(*js);
+
+  /* jobs that were never waited on are dropped, the workers have exited so
+   * their deques can be emptied from here */
+  for(Job * job = (*js)->head; job;)
+  {
+    Job * next = job->next;
+    free(job);
+    job = next;
+  }
+
+  for(unsigned int i = 0; i < (*js)->workers; ++i)
+  {
+    Job * job;
+    while((job = dequeTake(&(*js)->worker[i].deque)))
+      free(job);
+  }
+
+  pthread_cond_destroy (&(*js)->done);
+  pthread_cond_destroy (&(*js)->work);
+  pthread_mutex_destroy(&(*js)->lock);
+  free((*js)->worker);
+  free(*js);
+  *js = NULL;
+}
+
+unsigned int adlJobSystemGetWorkers(const ADLJobSystem * js)
+{
+  return js->workers;
+}
+
+ADL_STATUS adlJobSubmit(ADLJobSystem * js, ADLJobFn fn, void * udata,
+    ADLJobCounter * counter)
+{
+  if (!js || !fn)
+    return ADL_ERR_INVALID_ARGUMENT;
+
+  Job * job = malloc(sizeof(*job));
+  if (!job)
+  {
+    fn(udata);
+    return ADL_OK;
+  }
+
+  *job = (Job)
+  {
+    .fn      = fn,
+    .udata   = udata,
+    .counter = counter
+  };
+
+  if (counter)
+    atomic_fetch_add_explicit(&counter->pending, 1, memory_order_relaxed);
+
+  if (!jobQueue(js, job))
+    jobRun(js, job);
+
+  return ADL_OK;
+}
+
+ADL_STATUS adlJobParallelFor(ADLJobSystem * js, unsigned int count,
+    unsigned int grain, ADLJobRangeFn fn, void * udata,
+    ADLJobCounter * counter)
+{
+  if (!js || !fn || !counter)
+    return ADL_ERR_INVALID_ARGUMENT;
+
+  if (!count)
+    return ADL_OK;
+
+  if (!grain)
+  {
+    /* a few ranges per worker so the split balances uneven work */
+    grain = count / (js->workers * 4);
+    if (!grain)
+      grain = 1;
+  }
+
+  Job * job = malloc(sizeof(*job));
+  if (!job)
+  {
+    fn(0, count, udata);
+    return ADL_OK;
+  }
+
+  *job = (Job)
+  {
+    .rangeFn = fn,
+    .udata   = udata,
+    .start   = 0,
+    .end     = count,
+    .grain   = grain,
+    .counter = counter
+  };
+
+  atomic_fetch_add_explicit(&counter->pending, 1, memory_order_relaxed);
+  if (!jobQueue(js, job))
+    jobRun(js, job);
+
+  return ADL_OK;
+}
+
+void adlJobWait(ADLJobSystem * js, ADLJobCounter * counter)
+{
+  Worker * w = self && self->js == js ? self : NULL;
+  unsigned int idle = 0;
+
+  while(atomic_load_explicit(&counter->pending, memory_order_acquire))
+  {
+    Job * job = jobFind(js, w);
+    if (job)
+    {
+      jobRun(js, job);
+      idle = 0;
+      continue;
+    }
+
+    if (++idle < JOB_SPIN)
+    {
+      adlCPURelax();
+      continue;
+    }
+
+    /* woken when a counter reaches zero or new work is queued that we could
+     * help with */
+    idle = 0;
+    atomic_fetch_add(&js->waiters, 1);
+    pthread_mutex_lock(&js->lock);
+    while(atomic_load(&counter->pending) && atomic_load(&js->queued) <= 0)
+      pthread_cond_wait(&js->done, &js->lock);
+    pthread_mutex_unlock(&js->lock);
+    atomic_fetch_sub(&js->waiters, 1);
+  }
+}
@@ -0,0 +1,365 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "adl/logging.h"
+#include "adl/thread.h"
+#include "adl/util.h"
+#include "adl.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define ADL_LOG_FORMAT "%16" PRId64 " | %20s:%-4u | %-30s | "
+
+/* records longer than this are truncated */
+#define LOG_RECORD_SIZE 512
+/* number of records in the ring, must be a power of two */
+#define LOG_RING_SIZE   1024
+/* longest the writer sleeps when the ring is empty */
+#define LOG_IDLE_MAX_NS 4000000
+
+typedef struct
+{
+  atomic_size_t seq;
+  ADL_LOG_LEVEL level;
+  unsigned int  len;
+  char          text[LOG_RECORD_SIZE];
+}
+LogRecord;
+
+static struct
+{
+  bool                  running;
+  ADLThread             thread;
+  struct ADLLogHandlers prev;
+
+  /* serializes the consumer side of the ring between the writer thread and
+   * the synchronous fatal/bug path */
+  pthread_mutex_t drainLock;
+
+  /* handlers still running, adlLogAsyncStop waits for them after setting
+   * stopping so nothing is pushed after the final drain */
+  atomic_uint inFlight;
+  atomic_bool stopping;
+
+  _Alignas(64) atomic_size_t enqueue;
+  _Alignas(64) size_t        dequeue;
+  _Alignas(64) atomic_uint_least64_t dropped;
+
+  LogRecord ring[LOG_RING_SIZE];
+}
+logAsync;
+
+static _Thread_local char logBuffer[LOG_RECORD_SIZE];
+
+static void logPush(ADL_LOG_LEVEL level, const char * text, unsigned int len)
+{
+  size_t pos = atomic_load_explicit(&logAsync.enqueue, memory_order_relaxed);
+  LogRecord * rec;
+  for(;;)
+  {
+    rec = &logAsync.ring[pos & (LOG_RING_SIZE - 1)];
+    const size_t   seq  =
+      atomic_load_explicit(&rec->seq, memory_order_acquire);
+    const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0)
+    {
+      if (atomic_compare_exchange_weak_explicit(&logAsync.enqueue, &pos,
+            pos + 1, memory_order_relaxed, memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+    {
+      /* the ring is full, drop the record rather than block the caller */
+      atomic_fetch_add_explicit(&logAsync.dropped, 1, memory_order_relaxed);
+      return;
+    }
+    else
+      pos = atomic_load_explicit(&logAsync.enqueue, memory_order_relaxed);
+  }
+
+  rec->level = level;
+  rec->len   = len;
+  memcpy(rec->text, text, len);
+  atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+}
+
+static bool logPop(ADL_LOG_LEVEL * level, char * text, unsigned int * len)
+{
+  LogRecord * rec = &logAsync.ring[logAsync.dequeue & (LOG_RING_SIZE - 1)];
+  if (atomic_load_explicit(&rec->seq, memory_order_acquire) !=
+      logAsync.dequeue + 1)
+    return false;
+
+  *level = rec->level;
+  *len   = rec->len;
+  memcpy(text, rec->text, rec->len);
+
+  atomic_store_explicit(&rec->seq, logAsync.dequeue + LOG_RING_SIZE,
+      memory_order_release);
+  ++logAsync.dequeue;
+  return true;
+}
+
+/* returns false if the backend is stopping and the message must be written
+ * through the previous handlers, otherwise logLeave must be called */
+static bool logEnter(void)
+{
+  atomic_fetch_add(&logAsync.inFlight, 1);
+  if (!atomic_load(&logAsync.stopping))
+    return true;
+
+  atomic_fetch_sub(&logAsync.inFlight, 1);
+  return false;
+}
+
+static void logLeave(void)
+{
+  atomic_fetch_sub(&logAsync.inFlight, 1);
+}
+
+static ADLLogFn logPrev(ADL_LOG_LEVEL loglevel)
+{
+  switch(loglevel)
+  {
+    case ADL_LOG_WARN : return logAsync.prev.warn;
+    case ADL_LOG_BUG  : return logAsync.prev.bug;
+    case ADL_LOG_ERROR: return logAsync.prev.err;
+    case ADL_LOG_FATAL: return logAsync.prev.fatal;
+    default:
+      return logAsync.prev.info;
+  }
+}
+
+static void adlLogAsync(
+  ADL_LOG_LEVEL loglevel,
+  ADL_STATUS    status,
+  const char *  file,
+  unsigned int  line,
+  const char *  function,
+  const char *  format,
+  ...)
+{
+  va_list ap;
+  if (!logEnter())
+  {
+    va_start(ap, format);
+    vsnprintf(logBuffer, sizeof(logBuffer), format, ap);
+    va_end(ap);
+    logPrev(loglevel)(loglevel, status, file, line, function, "%s",
+        logBuffer);
+    return;
+  }
+
+  int len = snprintf(logBuffer, sizeof(logBuffer), ADL_LOG_FORMAT,
+      adlGetClockMS(), file, line, function);
+
+  if (len >= 0 && len < (int)sizeof(logBuffer))
+  {
+    va_start(ap, format);
+    len += vsnprintf(logBuffer + len, sizeof(logBuffer) - len, format, ap);
+    va_end(ap);
+  }
+
+  /* keep the line terminated if the record was truncated */
+  if (len < 0 || len >= (int)sizeof(logBuffer))
+  {
+    len = sizeof(logBuffer) - 1;
+    logBuffer[len - 1] = '\n';
+  }
+
+  logPush(loglevel, logBuffer, len);
+  logLeave();
+}
+
+/* write out all queued records, returns the number written, the caller must
+ * hold drainLock */
+static unsigned int logDrain(char * text)
+{
+  ADL_LOG_LEVEL level;
+  unsigned int  len;
+  unsigned int  count = 0;
+  bool          out   = false;
+  bool          err   = false;
+
+  while(logPop(&level, text, &len))
+  {
+    FILE * fp = level == ADL_LOG_INFO ? stdout : stderr;
+    fwrite(text, 1, len, fp);
+    out |= fp == stdout;
+    err |= fp == stderr;
+    ++count;
+  }
+
+  if (out)
+    fflush(stdout);
+  if (err)
+    fflush(stderr);
+
+  return count;
+}
+
+/* fatal and bug messages usually precede a crash or abort and must not sit
+ * in the ring, write out what is queued so ordering is kept and then hand the
+ * message to the previous handler on the caller's thread */
+static void adlLogSync(
+  ADL_LOG_LEVEL loglevel,
+  ADL_STATUS    status,
+  const char *  file,
+  unsigned int  line,
+  const char *  function,
+  const char *  format,
+  ...)
+{
+  va_list ap;
+  va_start(ap, format);
+  vsnprintf(logBuffer, sizeof(logBuffer), format, ap);
+  va_end(ap);
+
+  /* stopping, the ring has been or is about to be drained */
+  if (!logEnter())
+  {
+    logPrev(loglevel)(loglevel, status, file, line, function, "%s",
+        logBuffer);
+    return;
+  }
+
+  char text[LOG_RECORD_SIZE];
+  pthread_mutex_lock(&logAsync.drainLock);
+  logDrain(text);
+
+  logPrev(loglevel)(loglevel, status, file, line, function, "%s", logBuffer);
+  fflush(stdout);
+  fflush(stderr);
+  pthread_mutex_unlock(&logAsync.drainLock);
+  logLeave();
+}
+
+static void * logThread(ADLThread * thread, void * udata)
+{
+  char     text[LOG_RECORD_SIZE];
+  uint64_t idle     = 0;
+  /* the count is cumulative, only report drops from this session */
+  uint64_t reported =
+    atomic_load_explicit(&logAsync.dropped, memory_order_relaxed);
+
+  while(adlThreadIsRunning(thread))
+  {
+    const uint64_t dropped =
+      atomic_load_explicit(&logAsync.dropped, memory_order_relaxed);
+    if (dropped != reported)
+    {
+      fprintf(stderr, ADL_LOG_FORMAT "%" PRIu64 " log records dropped\n",
+          adlGetClockMS(), "logasync.c", __LINE__, __FUNCTION__,
+          dropped - reported);
+      reported = dropped;
+    }
+
+    pthread_mutex_lock(&logAsync.drainLock);
+    const unsigned int count = logDrain(text);
+    pthread_mutex_unlock(&logAsync.drainLock);
+
+    if (count)
+    {
+      idle = 0;
+      continue;
+    }
+
+    /* back off while there is nothing to write */
+    idle = idle ? idle * 2 : 100000;
+    if (idle > LOG_IDLE_MAX_NS)
+      idle = LOG_IDLE_MAX_NS;
+    adlWaitUntilNS(adlGetClockNS() + idle);
+  }
+
+  pthread_mutex_lock(&logAsync.drainLock);
+  logDrain(text);
+  pthread_mutex_unlock(&logAsync.drainLock);
+  return NULL;
+}
+
+ADL_STATUS adlLogAsyncStart(void)
+{
+  if (logAsync.running)
+    return ADL_OK;
+
+  for(size_t i = 0; i < LOG_RING_SIZE; ++i)
+    atomic_store(&logAsync.ring[i].seq, i);
+  atomic_store(&logAsync.enqueue, 0);
+  logAsync.dequeue = 0;
+  atomic_store(&logAsync.stopping, false);
+  pthread_mutex_init(&logAsync.drainLock, NULL);
+
+  ADL_STATUS status;
+  const ADLThreadAttr attr = { .name = "adl-log" };
+  if ((status = adlThreadCreateEx(logThread, NULL, &attr, &logAsync.thread,
+      NULL)) != ADL_OK)
+  {
+    pthread_mutex_destroy(&logAsync.drainLock);
+    ADL_ERROR(status, "failed to start the log writer thread");
+    return status;
+  }
+
+  logAsync.prev    = adlLogHandlers;
+  logAsync.running = true;
+  ADLSetLogHandlers((struct ADLLogHandlers)
+  {
+    .info  = adlLogAsync,
+    .warn  = adlLogAsync,
+    .bug   = adlLogSync,
+    .err   = adlLogAsync,
+    .fatal = adlLogSync
+  });
+
+  return ADL_OK;
+}
+
+void adlLogAsyncStop(void)
+{
+  if (!logAsync.running)
+    return;
+
+  /* handlers that loaded the old pointers may still be running, turn new
+   * ones away and wait out the rest before the final drain */
+  ADLSetLogHandlers(logAsync.prev);
+  atomic_store(&logAsync.stopping, true);
+  while(atomic_load(&logAsync.inFlight))
+    adlWaitUntilNS(adlGetClockNS() + 100000);
+
+  adlThreadStop(&logAsync.thread);
+  adlThreadJoin(&logAsync.thread, NULL, -1);
+  pthread_mutex_destroy(&logAsync.drainLock);
+  logAsync.running = false;
+}
+
+uint64_t adlLogAsyncDropped(void)
+{
+  return atomic_load_explicit(&logAsync.dropped, memory_order_relaxed);
+}
@@ -76,7 +76,16 @@ struct ADLLogHandlers adlLogHandlers =
   .fatal = adlLogStderr
 };
 
+unsigned int adlLogLevelMask = ~0U;
+
 void ADLSetLogHandlers(const struct ADLLogHandlers log)
 {
   adlLogHandlers = log;
 }
+
+void ADLSetLogHandlersMask(const struct ADLLogHandlers log,
+    unsigned int levelMask)
+{
+  adlLogHandlers  = log;
+  adlLogLevelMask = levelMask;
+}
@@ -0,0 +1,150 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "adl/pacer.h"
+#include "adl/util.h"
+
+#include <string.h>
+
+/* presents more than this fraction away from a whole number of periods are
+ * ignored when locking, eg: the first present after a stall */
+#define LOCK_TOLERANCE 8
+
+/* weight of each new sample in the period estimate, as 1/n */
+#define LOCK_WEIGHT 16
+
+ADL_STATUS adlFramePacerInit(ADLFramePacer * pacer, uint64_t periodNS)
+{
+  if (!pacer || !periodNS)
+    return ADL_ERR_INVALID_ARGUMENT;
+
+  memset(pacer, 0, sizeof(*pacer));
+  pacer->period = periodNS;
+  pacer->epoch  = adlGetClockNS() + periodNS;
+  return ADL_OK;
+}
+
+static inline uint64_t deadline(const ADLFramePacer * pacer, uint64_t frame)
+{
+  return pacer->epoch + (frame - pacer->epochFrame) * pacer->period;
+}
+
+void adlFramePacerWait(ADLFramePacer * pacer, uint64_t * frame)
+{
+  ADLFramePacerStats * s = &pacer->stats;
+  uint64_t next = deadline(pacer, pacer->frame);
+  uint64_t now  = adlGetClockNS();
+
+  if (now < next)
+  {
+    adlWaitUntilNS(next);
+    now = adlGetClockNS();
+
+    const uint64_t us = (now - next) / 1000;
+    unsigned int   b  = us ? 64 - __builtin_clzll(us) : 0;
+    if (b >= ADL_PACER_OVERSHOOT_BUCKETS)
+      b = ADL_PACER_OVERSHOOT_BUCKETS - 1;
+    ++s->overshoot[b];
+  }
+  else
+  {
+    /* late, drop the deadlines that have passed entirely so the next one is
+     * the end of the current period */
+    ++s->missed;
+    const uint64_t passed = (now - next) / pacer->period;
+    s->skipped   += passed;
+    pacer->frame += passed;
+  }
+
+  if (pacer->lastWake)
+  {
+    unsigned int b = (now - pacer->lastWake) / 1000000;
+    if (b >= ADL_PACER_FRAME_BUCKETS)
+      b = ADL_PACER_FRAME_BUCKETS - 1;
+    ++s->frameTime[b];
+  }
+
+  pacer->lastWake = now;
+  ++s->frames;
+
+  if (frame)
+    *frame = pacer->frame;
+  ++pacer->frame;
+}
+
+void adlFramePacerSetLock(ADLFramePacer * pacer, bool lock)
+{
+  pacer->lock        = lock;
+  pacer->lastPresent = 0;
+}
+
+void adlFramePacerPresented(ADLFramePacer * pacer, uint64_t clockNS)
+{
+  if (!pacer->lock)
+    return;
+
+  const uint64_t last = pacer->lastPresent;
+  pacer->lastPresent  = clockNS;
+  if (!last || clockNS <= last)
+    return;
+
+  /* the presents may be several periods apart if frames were missed */
+  const uint64_t interval = clockNS - last;
+  const uint64_t periods  =
+    (interval + pacer->period / 2) / pacer->period;
+  if (!periods)
+    return;
+
+  const uint64_t sample = interval / periods;
+  const uint64_t error  = sample > pacer->period ?
+    sample - pacer->period : pacer->period - sample;
+  if (error > pacer->period / LOCK_TOLERANCE)
+    return;
+
+  pacer->period = (pacer->period * (LOCK_WEIGHT - 1) + sample) / LOCK_WEIGHT;
+
+  /* rebase on the present so the following deadlines share its phase */
+  pacer->epochFrame = pacer->frame;
+  pacer->epoch      = clockNS;
+  while(pacer->epoch <= adlGetClockNS())
+    pacer->epoch += pacer->period;
+}
+
+uint64_t adlFramePacerGetPeriod(const ADLFramePacer * pacer)
+{
+  return pacer->period;
+}
+
+void adlFramePacerGetStats(const ADLFramePacer * pacer,
+    ADLFramePacerStats * stats)
+{
+  *stats = pacer->stats;
+}
+
+void adlFramePacerResetStats(ADLFramePacer * pacer)
+{
+  memset(&pacer->stats, 0, sizeof(pacer->stats));
+  pacer->lastWake = 0;
+}
@@ -0,0 +1,264 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "profile.h"
+#include "adl.h"
+
+#include <string.h>
+#include <stdatomic.h>
+
+/* latencies are bucketed by their power of two with 8 linear sub buckets,
+ * giving at most 12.5% error, everything over 2^40ns goes in the last */
+#define PROFILE_SUB_BITS 3
+#define PROFILE_SUB      (1 << PROFILE_SUB_BITS)
+#define PROFILE_MAX_EXP  40
+#define PROFILE_BUCKETS  ((PROFILE_MAX_EXP - PROFILE_SUB_BITS + 2) * PROFILE_SUB)
+
+/* the index of every entry point */
+#undef  ADL_DATA_FIELD
+#define ADL_DATA_FIELD(type, name)
+#define ADL_FIELD(type, name) PROFILE_##name,
+enum
+{
+  ADL_PLATFORM_FIELDS
+  PROFILE_COUNT
+};
+#undef ADL_FIELD
+
+#define ADL_FIELD(type, name) #name,
+static const char * profileNames[PROFILE_COUNT] =
+{
+  ADL_PLATFORM_FIELDS
+};
+#undef ADL_FIELD
+
+typedef struct
+{
+  atomic_uint_fast64_t count;
+  atomic_uint_fast64_t totalNS;
+  atomic_uint_fast64_t minNS;
+  atomic_uint_fast64_t maxNS;
+  atomic_uint_fast64_t histogram[PROFILE_BUCKETS];
+}
+ProfileStats;
+
+static const struct ADLPlatform * real;
+static struct ADLPlatform         wrapped;
+static ProfileStats               stats[PROFILE_COUNT];
+
+static inline unsigned int profileBucket(uint64_t ns)
+{
+  if (ns < PROFILE_SUB)
+    return ns;
+
+  unsigned int exp = 63 - __builtin_clzll(ns);
+  if (exp > PROFILE_MAX_EXP)
+    return PROFILE_BUCKETS - 1;
+
+  const unsigned int sub = (ns >> (exp - PROFILE_SUB_BITS)) & (PROFILE_SUB - 1);
+  return (exp - PROFILE_SUB_BITS + 1) * PROFILE_SUB + sub;
+}
+
+/* the largest value that falls into the bucket */
+static uint64_t profileBucketMax(unsigned int bucket)
+{
+  if (bucket < PROFILE_SUB)
+    return bucket;
+
+  const unsigned int exp = bucket / PROFILE_SUB + PROFILE_SUB_BITS - 1;
+  const uint64_t     sub = bucket % PROFILE_SUB;
+  return ((PROFILE_SUB + sub + 1) << (exp - PROFILE_SUB_BITS)) - 1;
+}
+
+static void profileRecord(unsigned int index, uint64_t ns)
+{
+  ProfileStats * s = &stats[index];
+
+  atomic_fetch_add_explicit(&s->count  , 1 , memory_order_relaxed);
+  atomic_fetch_add_explicit(&s->totalNS, ns, memory_order_relaxed);
+  atomic_fetch_add_explicit(&s->histogram[profileBucket(ns)], 1,
+      memory_order_relaxed);
+
+  /* minNS is stored inverted so that zero means no calls for both */
+  uint64_t old = atomic_load_explicit(&s->minNS, memory_order_relaxed);
+  while(~ns > old && !atomic_compare_exchange_weak_explicit(&s->minNS, &old,
+        ~ns, memory_order_relaxed, memory_order_relaxed)) {}
+
+  old = atomic_load_explicit(&s->maxNS, memory_order_relaxed);
+  while(ns > old && !atomic_compare_exchange_weak_explicit(&s->maxNS, &old,
+        ns, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+#define PROFILE_CALL(_name, _params, _args) \
+  static ADL_STATUS profile_##_name _params \
+  { \
+    const uint64_t start  = adlGetClockNS(); \
+    const ADL_STATUS status = real->_name _args; \
+    profileRecord(PROFILE_##_name, adlGetClockNS() - start); \
+    return status; \
+  }
+
+/* the parameters of each entry point type in interface/adl.h */
+#define PROFILE_ADLPf(n) \
+  PROFILE_CALL(n, (void), ())
+#define PROFILE_ADLPfProcessEvent(n) \
+  PROFILE_CALL(n, (int timeout, ADLEvent * event), (timeout, event))
+#define PROFILE_ADLPfWindowCreate(n) \
+  PROFILE_CALL(n, (const ADLWindowDef def, ADLWindow * result), \
+      (def, result))
+#define PROFILE_ADLPfWindow(n) \
+  PROFILE_CALL(n, (ADLWindow * window), (window))
+#define PROFILE_ADLPfWindowEvent(n) \
+  PROFILE_CALL(n, (ADLWindow * window, ADLEvent * event), (window, event))
+#define PROFILE_ADLPfWindowSetStr(n) \
+  PROFILE_CALL(n, (ADLWindow * window, const char * str), (window, str))
+#define PROFILE_ADLPfWindowSetBool(n) \
+  PROFILE_CALL(n, (ADLWindow * window, bool enable), (window, enable))
+#define PROFILE_ADLPfImageGetSupported(n) \
+  PROFILE_CALL(n, (const ADLImageBackend ** result), (result))
+#define PROFILE_ADLPfImageCreate(n) \
+  PROFILE_CALL(n, (ADLWindow * window, const ADLImageDef def, \
+        ADLImage * result), (window, def, result))
+#define PROFILE_ADLPfImage(n) \
+  PROFILE_CALL(n, (ADLImage * image), (image))
+#define PROFILE_ADLPfImageRects(n) \
+  PROFILE_CALL(n, (ADLImage * image, const void * buffer, \
+        const ADLRect * rects, unsigned int count), \
+      (image, buffer, rects, count))
+#define PROFILE_ADLPfImagePresentAt(n) \
+  PROFILE_CALL(n, (ADLImage * image, int x, int y, const ADLRect * src), \
+      (image, x, y, src))
+#define PROFILE_ADLPfPointer(n) \
+  PROFILE_CALL(n, (ADLWindow * window, int x, int y), (window, x, y))
+#define PROFILE_ADLPfPointerCursor(n) \
+  PROFILE_CALL(n, (ADLWindow * window, ADLImage * source, ADLImage * mask, \
+        int x, int y), (window, source, mask, x, y))
+#define PROFILE_ADLPfEGLGetDisplay(n) \
+  PROFILE_CALL(n, (EGLDisplay ** display), (display))
+#define PROFILE_ADLPfEGLCreateWindowSurface(n) \
+  PROFILE_CALL(n, (EGLDisplay * display, EGLint * config, \
+        ADLWindow * window, const EGLint * attribs, EGLSurface * surface), \
+      (display, config, window, attribs, surface))
+
+#define ADL_FIELD(type, name) PROFILE_##type(name)
+ADL_PLATFORM_FIELDS
+#undef ADL_FIELD
+
+const struct ADLPlatform * adlProfileWrap(const struct ADLPlatform * platform)
+{
+  real    = platform;
+  wrapped = *platform;
+
+  #define ADL_FIELD(type, name) wrapped.name = profile_##name;
+  ADL_PLATFORM_FIELDS
+  #undef ADL_FIELD
+
+  return &wrapped;
+}
+
+ADL_STATUS adlSetPlatformProfiling(bool enable)
+{
+  ADL_INITCHECK;
+
+  if (adl.platform)
+  {
+    ADL_ERROR(ADL_ERR_BUSY, "must be called before adlUsePlatform");
+    return ADL_ERR_BUSY;
+  }
+
+  adl.profile = enable;
+  return ADL_OK;
+}
+
+ADL_STATUS adlGetPlatformCallStats(ADLCallStats * out, unsigned int max,
+    unsigned int * count)
+{
+  ADL_INITCHECK;
+  ADL_NOT_NULL_CHECK(count);
+
+  *count = PROFILE_COUNT;
+  if (adl.platform != &wrapped)
+    return ADL_ERR_UNSUPPORTED;
+
+  if (!out)
+    return ADL_OK;
+
+  for(unsigned int i = 0; i < PROFILE_COUNT && i < max; ++i)
+  {
+    ProfileStats * s = &stats[i];
+    ADLCallStats * o = &out[i];
+
+    o->name  = profileNames[i];
+    o->count = atomic_load_explicit(&s->count, memory_order_relaxed);
+    o->minNS = ~atomic_load_explicit(&s->minNS, memory_order_relaxed);
+    o->maxNS = atomic_load_explicit(&s->maxNS, memory_order_relaxed);
+    o->avgNS = o->p99NS = 0;
+
+    if (!o->count)
+    {
+      o->minNS = 0;
+      continue;
+    }
+
+    o->avgNS = atomic_load_explicit(&s->totalNS, memory_order_relaxed) /
+      o->count;
+
+    /* the bucket holding the 99th percentile call */
+    const uint64_t rank = o->count - o->count / 100;
+    uint64_t       seen = 0;
+    for(unsigned int b = 0; b < PROFILE_BUCKETS; ++b)
+    {
+      seen += atomic_load_explicit(&s->histogram[b], memory_order_relaxed);
+      if (seen >= rank)
+      {
+        o->p99NS = profileBucketMax(b);
+        break;
+      }
+    }
+
+    if (o->p99NS > o->maxNS)
+      o->p99NS = o->maxNS;
+  }
+
+  return ADL_OK;
+}
+
+ADL_STATUS adlResetPlatformCallStats(void)
+{
+  ADL_INITCHECK;
+
+  for(unsigned int i = 0; i < PROFILE_COUNT; ++i)
+  {
+    ProfileStats * s = &stats[i];
+    atomic_store_explicit(&s->count  , 0, memory_order_relaxed);
+    atomic_store_explicit(&s->totalNS, 0, memory_order_relaxed);
+    atomic_store_explicit(&s->minNS  , 0, memory_order_relaxed);
+    atomic_store_explicit(&s->maxNS  , 0, memory_order_relaxed);
+    for(unsigned int b = 0; b < PROFILE_BUCKETS; ++b)
+      atomic_store_explicit(&s->histogram[b], 0, memory_order_relaxed);
+  }
+
+  return ADL_OK;
+}
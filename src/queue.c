@@ -0,0 +1,326 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "adl/queue.h"
+#include "adl/logging.h"
+#include "adl/util.h"
+#include "futex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef bool (*QueueOpFn)(void * queue, void * item);
+
+static bool queueCapacity(unsigned int * capacity)
+{
+  if (*capacity == 0 || *capacity > (1U << 31))
+    return false;
+
+  unsigned int c = 1;
+  while(c < *capacity)
+    c <<= 1;
+  *capacity = c;
+  return true;
+}
+
+/* the fence orders the caller's publish before the load of `waiters`, a waiter
+ * increments `waiters` before it rechecks the queue so one of the two always
+ * sees the other */
+static inline void queueNotify(atomic_uint * futex, atomic_uint * waiters)
+{
+  atomic_thread_fence(memory_order_seq_cst);
+  if (!atomic_load_explicit(waiters, memory_order_relaxed))
+    return;
+
+  /* producers and consumers share the futex so wake them all to recheck */
+  atomic_fetch_add(futex, 1);
+  futexWake(futex, true);
+}
+
+static ADL_STATUS queueWait(atomic_uint * futex, atomic_uint * waiters,
+    QueueOpFn op, void * queue, void * item, int64_t timeoutNS)
+{
+  if (op(queue, item))
+    return ADL_OK;
+
+  if (timeoutNS == 0)
+    return ADL_ERR_BUSY;
+
+  const uint64_t deadline = timeoutNS < 0 ?
+    FUTEX_FOREVER : adlGetClockNS() + (uint64_t)timeoutNS;
+
+  for(;;)
+  {
+    atomic_fetch_add(waiters, 1);
+    const unsigned int seq = atomic_load(futex);
+    if (op(queue, item))
+    {
+      atomic_fetch_sub(waiters, 1);
+      return ADL_OK;
+    }
+
+    const bool woken = futexWait(futex, seq, deadline);
+    atomic_fetch_sub(waiters, 1);
+
+    if (op(queue, item))
+      return ADL_OK;
+
+    if (!woken)
+      return ADL_ERR_TIMEOUT;
+  }
+}
+
+ADL_STATUS adlSPSCQueueInit(ADLSPSCQueue * queue, unsigned int capacity,
+    size_t itemSize, unsigned int flags)
+{
+  if (!queue || !itemSize || !queueCapacity(&capacity))
+    return ADL_ERR_INVALID_ARGUMENT;
+
+  memset(queue, 0, sizeof(*queue));
+  queue->items = malloc(capacity * itemSize);
+  if (!queue->items)
+  {
+    ADL_ERROR(ADL_ERR_NO_MEM, "failed to allocate the queue");
+    return ADL_ERR_NO_MEM;
+  }
+
+  queue->mask     = capacity - 1;
+  queue->itemSize = itemSize;
+  queue->flags    = flags;
+  return ADL_OK;
+}
+
+void adlSPSCQueueFree(ADLSPSCQueue * queue)
+{
+  free(queue->items);
+  queue->items = NULL;
+}
+
+bool adlSPSCQueuePush(ADLSPSCQueue * queue, const void * item)
+{
+  const unsigned int tail =
+    atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+  /* only reload the consumer's index when the cached one says we are full */
+  if (tail - queue->cachedHead > queue->mask)
+  {
+    queue->cachedHead =
+      atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - queue->cachedHead > queue->mask)
+      return false;
+  }
+
+  memcpy(queue->items + (tail & queue->mask) * queue->itemSize, item,
+      queue->itemSize);
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+  if (queue->flags & ADL_QUEUE_BLOCKING)
+    queueNotify(&queue->futex, &queue->waiters);
+  return true;
+}
+
+bool adlSPSCQueuePop(ADLSPSCQueue * queue, void * item)
+{
+  const unsigned int head =
+    atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+  if (head == queue->cachedTail)
+  {
+    queue->cachedTail =
+      atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == queue->cachedTail)
+      return false;
+  }
+
+  memcpy(item, queue->items + (head & queue->mask) * queue->itemSize,
+      queue->itemSize);
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+  if (queue->flags & ADL_QUEUE_BLOCKING)
+    queueNotify(&queue->futex, &queue->waiters);
+  return true;
+}
+
+static bool spscPush(void * queue, void * item)
+{
+  return adlSPSCQueuePush((ADLSPSCQueue *)queue, item);
+}
+
+static bool spscPop(void * queue, void * item)
+{
+  return adlSPSCQueuePop((ADLSPSCQueue *)queue, item);
+}
+
+ADL_STATUS adlSPSCQueuePushWait(ADLSPSCQueue * queue, const void * item,
+    int64_t timeoutNS)
+{
+  if (!(queue->flags & ADL_QUEUE_BLOCKING))
+    return ADL_ERR_UNSUPPORTED;
+
+  return queueWait(&queue->futex, &queue->waiters, spscPush, queue,
+      (void *)item, timeoutNS);
+}
+
+ADL_STATUS adlSPSCQueuePopWait(ADLSPSCQueue * queue, void * item,
+    int64_t timeoutNS)
+{
+  if (!(queue->flags & ADL_QUEUE_BLOCKING))
+    return ADL_ERR_UNSUPPORTED;
+
+  return queueWait(&queue->futex, &queue->waiters, spscPop, queue, item,
+      timeoutNS);
+}
+
+ADL_STATUS adlMPMCQueueInit(ADLMPMCQueue * queue, unsigned int capacity,
+    size_t itemSize, unsigned int flags)
+{
+  if (!queue || !itemSize || !queueCapacity(&capacity))
+    return ADL_ERR_INVALID_ARGUMENT;
+
+  memset(queue, 0, sizeof(*queue));
+  queue->seq   = malloc(capacity * sizeof(*queue->seq));
+  queue->items = malloc(capacity * itemSize);
+  if (!queue->seq || !queue->items)
+  {
+    free(queue->seq);
+    free(queue->items);
+    ADL_ERROR(ADL_ERR_NO_MEM, "failed to allocate the queue");
+    return ADL_ERR_NO_MEM;
+  }
+
+  for(unsigned int i = 0; i < capacity; ++i)
+    atomic_init(&queue->seq[i], i);
+
+  queue->mask     = capacity - 1;
+  queue->itemSize = itemSize;
+  queue->flags    = flags;
+  return ADL_OK;
+}
+
+void adlMPMCQueueFree(ADLMPMCQueue * queue)
+{
+  free(queue->seq);
+  free(queue->items);
+  queue->seq   = NULL;
+  queue->items = NULL;
+}
+
+/* a slot is free for the producer of position `pos` when its sequence equals
+ * `pos` and holds an item for the consumer of `pos` when it equals `pos + 1`,
+ * consuming advances it by the capacity to free it for the next lap */
+bool adlMPMCQueuePush(ADLMPMCQueue * queue, const void * item)
+{
+  unsigned int pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  unsigned int slot;
+
+  for(;;)
+  {
+    slot = pos & queue->mask;
+    const unsigned int seq =
+      atomic_load_explicit(&queue->seq[slot], memory_order_acquire);
+    const int diff = (int)(seq - pos);
+
+    if (diff == 0)
+    {
+      if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1,
+            memory_order_relaxed, memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+      return false;
+    else
+      pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  }
+
+  memcpy(queue->items + slot * queue->itemSize, item, queue->itemSize);
+  atomic_store_explicit(&queue->seq[slot], pos + 1, memory_order_release);
+
+  if (queue->flags & ADL_QUEUE_BLOCKING)
+    queueNotify(&queue->futex, &queue->waiters);
+  return true;
+}
+
+bool adlMPMCQueuePop(ADLMPMCQueue * queue, void * item)
+{
+  unsigned int pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  unsigned int slot;
+
+  for(;;)
+  {
+    slot = pos & queue->mask;
+    const unsigned int seq =
+      atomic_load_explicit(&queue->seq[slot], memory_order_acquire);
+    const int diff = (int)(seq - (pos + 1));
+
+    if (diff == 0)
+    {
+      if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1,
+            memory_order_relaxed, memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+      return false;
+    else
+      pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  }
+
+  memcpy(item, queue->items + slot * queue->itemSize, queue->itemSize);
+  atomic_store_explicit(&queue->seq[slot], pos + queue->mask + 1,
+      memory_order_release);
+
+  if (queue->flags & ADL_QUEUE_BLOCKING)
+    queueNotify(&queue->futex, &queue->waiters);
+  return true;
+}
+
+static bool mpmcPush(void * queue, void * item)
+{
+  return adlMPMCQueuePush((ADLMPMCQueue *)queue, item);
+}
+
+static bool mpmcPop(void * queue, void * item)
+{
+  return adlMPMCQueuePop((ADLMPMCQueue *)queue, item);
+}
+
+ADL_STATUS adlMPMCQueuePushWait(ADLMPMCQueue * queue, const void * item,
+    int64_t timeoutNS)
+{
+  if (!(queue->flags & ADL_QUEUE_BLOCKING))
+    return ADL_ERR_UNSUPPORTED;
+
+  return queueWait(&queue->futex, &queue->waiters, mpmcPush, queue,
+      (void *)item, timeoutNS);
+}
+
+ADL_STATUS adlMPMCQueuePopWait(ADLMPMCQueue * queue, void * item,
+    int64_t timeoutNS)
+{
+  if (!(queue->flags & ADL_QUEUE_BLOCKING))
+    return ADL_ERR_UNSUPPORTED;
+
+  return queueWait(&queue->futex, &queue->waiters, mpmcPop, queue, item,
+      timeoutNS);
+}
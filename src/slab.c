@@ -0,0 +1,144 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "slab.h"
+#include "adl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdalign.h>
+#include <assert.h>
+
+#define SLAB_ALIGN alignof(max_align_t)
+#define SLAB_ROUND(x) (((x) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+struct _ADLSlabChunk
+{
+  ADLSlabChunk * next;
+};
+
+ADL_STATUS adlSlabNew(const size_t itemSize, unsigned int perChunk,
+    ADLSlab * slab)
+{
+  if (!slab)
+  {
+    ADL_BUG(ADL_ERR_INVALID_ARGUMENT, "slab == NULL");
+    return ADL_ERR_INVALID_ARGUMENT;
+  }
+
+  if (!itemSize || !perChunk)
+  {
+    ADL_BUG(ADL_ERR_INVALID_ARGUMENT, "itemSize and perChunk must be > 0");
+    return ADL_ERR_INVALID_ARGUMENT;
+  }
+
+  memset(slab, 0, sizeof(*slab));
+  /* free blocks store the free list link in place */
+  slab->size     = SLAB_ROUND(itemSize < sizeof(void *) ?
+      sizeof(void *) : itemSize);
+  slab->perChunk = perChunk;
+
+  return ADL_OK;
+}
+
+void adlSlabFree(ADLSlab * slab)
+{
+  assert(slab);
+
+  if (slab->stats.inUse)
+    ADL_BUG(ADL_ERR_BUSY, "freeing a slab with %" PRIu64 " blocks in use",
+        slab->stats.inUse);
+
+  ADLSlabChunk * next;
+  for(ADLSlabChunk * chunk = slab->chunks; chunk; chunk = next)
+  {
+    next = chunk->next;
+    free(chunk);
+  }
+
+  slab->chunks   = NULL;
+  slab->freeList = NULL;
+}
+
+ADL_STATUS adlSlabAlloc(ADLSlab * slab, void ** result)
+{
+  assert(slab);
+  assert(result);
+  assert(slab->size > 0);
+
+  *result = NULL;
+
+  if (slab->freeList)
+    ++slab->stats.avoided;
+  else
+  {
+    ADLSlabChunk * chunk = malloc(SLAB_ROUND(sizeof(*chunk)) +
+        slab->size * slab->perChunk);
+    if (!chunk)
+    {
+      ADL_ERROR(ADL_ERR_NO_MEM, "unable to allocate a slab chunk of %zu bytes",
+          slab->size * slab->perChunk);
+      return ADL_ERR_NO_MEM;
+    }
+
+    chunk->next  = slab->chunks;
+    slab->chunks = chunk;
+    ++slab->stats.chunks;
+
+    /* thread the new blocks onto the free list in address order */
+    uint8_t * base = (uint8_t *)chunk + SLAB_ROUND(sizeof(*chunk));
+    for(unsigned int i = slab->perChunk; i > 0; --i)
+    {
+      void ** block = (void **)(base + (i - 1) * slab->size);
+      *block = slab->freeList;
+      slab->freeList = block;
+    }
+  }
+
+  void ** block  = slab->freeList;
+  slab->freeList = *block;
+
+  memset(block, 0, slab->size);
+  ++slab->stats.allocs;
+  ++slab->stats.inUse;
+
+  *result = block;
+  return ADL_OK;
+}
+
+void adlSlabRelease(ADLSlab * slab, void * block)
+{
+  assert(slab);
+  assert(slab->stats.inUse > 0);
+
+  if (!block)
+    return;
+
+  *(void **)block = slab->freeList;
+  slab->freeList  = block;
+  --slab->stats.inUse;
+}
@@ -22,50 +22,36 @@
   SOFTWARE.
 */
 
-#ifndef _H_SRC_LINKEDLIST
-#define _H_SRC_LINKEDLIST
+
+#ifndef _H_SRC_SLAB
+#define _H_SRC_SLAB
 
 #include "adl/status.h"
+#include "adl/adl.h"
 
 #include <stddef.h>
-#include <stdbool.h>
-
-typedef struct _ADLLinkedListItem
-{
-  struct _ADLLinkedListItem * prev;
-  struct _ADLLinkedListItem * next;
-}
-ADLLinkedListItem;
 
-// destructor
-typedef void (* ADLLinkedListItemDtor)(ADLLinkedListItem * item);
-
-// iterator
-typedef bool (* ADLLinkedListItemItor)(ADLLinkedListItem * item, void * udata);
+typedef struct _ADLSlabChunk ADLSlabChunk;
 
+/* fixed size blocks carved from larger chunks, freed blocks are kept on a
+ * free list for reuse and chunks are only returned to the heap by
+ * adlSlabFree */
 typedef struct
 {
-  size_t                size;
-  unsigned int          count;
-  ADLLinkedListItemDtor dtor;
-  ADLLinkedListItem *   head;
-  ADLLinkedListItem *   tail;
+  size_t         size;
+  unsigned int   perChunk;
+  ADLSlabChunk * chunks;
+  void         * freeList;
+  ADLAllocStats  stats;
 }
-ADLLinkedList;
-
-ADL_STATUS adlLinkedListNew(const size_t itemSize, ADLLinkedListItemDtor dtor,
-    ADLLinkedList * list);
-ADL_STATUS adlLinkedListFree(ADLLinkedList * list);
-
-ADL_STATUS adlLinkedListNewItem(ADLLinkedList * list,
-    ADLLinkedListItem ** result);
+ADLSlab;
 
-ADL_STATUS adlLinkedListPush  (ADLLinkedList * list, ADLLinkedListItem *  data);
-ADL_STATUS adlLinkedListPop   (ADLLinkedList * list, ADLLinkedListItem ** result);
-ADL_STATUS adlLinkedListRemove(ADLLinkedList * list, ADLLinkedListItem ** item,
-    bool freeItem);
+ADL_STATUS adlSlabNew(const size_t itemSize, unsigned int perChunk,
+    ADLSlab * slab);
+void adlSlabFree(ADLSlab * slab);
 
-void adlLinkedListIterate(ADLLinkedList * list, ADLLinkedListItemItor itor,
-    void * udata);
+/* allocate a zeroed block */
+ADL_STATUS adlSlabAlloc(ADLSlab * slab, void ** result);
+void adlSlabRelease(ADLSlab * slab, void * block);
 
 #endif
@@ -0,0 +1,237 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "adl/sync.h"
+#include "adl/util.h"
+#include "futex.h"
+
+/* iterations to spin before sleeping, long enough to cover a post that is
+ * about to happen on another core */
+#define SYNC_SPIN 64
+
+static inline int64_t msToNS(int timeout)
+{
+  return timeout < 0 ? -1 : (int64_t)timeout * 1000000LL;
+}
+
+static inline uint64_t syncDeadline(int64_t timeoutNS)
+{
+  return timeoutNS < 0 ? FUTEX_FOREVER : adlGetClockNS() + timeoutNS;
+}
+
+/* sleep while `*word == expected`, `waiters` lets the waker skip the syscall
+ * when nobody is sleeping */
+static inline bool syncSleep(atomic_uint * word, unsigned int expected,
+    atomic_uint * waiters, uint64_t deadline)
+{
+  atomic_fetch_add(waiters, 1);
+  const bool woken = futexWait(word, expected, deadline);
+  atomic_fetch_sub(waiters, 1);
+  return woken;
+}
+
+static inline void syncWake(atomic_uint * word, atomic_uint * waiters,
+    bool all)
+{
+  if (atomic_load(waiters))
+    futexWake(word, all);
+}
+
+void adlSemaphoreInit(ADLSemaphore * sem, unsigned int count)
+{
+  atomic_init(&sem->count  , count);
+  atomic_init(&sem->waiters, 0);
+}
+
+void adlSemaphorePost(ADLSemaphore * sem)
+{
+  atomic_fetch_add(&sem->count, 1);
+  syncWake(&sem->count, &sem->waiters, false);
+}
+
+static bool semaphoreTake(ADLSemaphore * sem)
+{
+  unsigned int count = atomic_load_explicit(&sem->count, memory_order_relaxed);
+  while(count)
+    if (atomic_compare_exchange_weak_explicit(&sem->count, &count, count - 1,
+          memory_order_acquire, memory_order_relaxed))
+      return true;
+  return false;
+}
+
+ADL_STATUS adlSemaphoreWaitNS(ADLSemaphore * sem, int64_t timeoutNS)
+{
+  if (semaphoreTake(sem))
+    return ADL_OK;
+
+  if (timeoutNS == 0)
+    return ADL_ERR_BUSY;
+
+  for(int i = 0; i < SYNC_SPIN; ++i)
+  {
+    adlCPURelax();
+    if (semaphoreTake(sem))
+      return ADL_OK;
+  }
+
+  const uint64_t deadline = syncDeadline(timeoutNS);
+  for(;;)
+  {
+    const bool woken = syncSleep(&sem->count, 0, &sem->waiters, deadline);
+    if (semaphoreTake(sem))
+      return ADL_OK;
+
+    if (!woken)
+      return ADL_ERR_TIMEOUT;
+  }
+}
+
+ADL_STATUS adlSemaphoreWait(ADLSemaphore * sem, int timeout)
+{
+  return adlSemaphoreWaitNS(sem, msToNS(timeout));
+}
+
+void adlSignalInit(ADLSignal * signal, bool manual, bool set)
+{
+  atomic_init(&signal->state  , set ? 1 : 0);
+  atomic_init(&signal->waiters, 0);
+  signal->manual = manual;
+}
+
+void adlSignalSet(ADLSignal * signal)
+{
+  if (atomic_exchange(&signal->state, 1) == 1)
+    return;
+
+  syncWake(&signal->state, &signal->waiters, signal->manual);
+}
+
+void adlSignalReset(ADLSignal * signal)
+{
+  atomic_store(&signal->state, 0);
+}
+
+/* an auto reset signal is consumed by the waiter that sees it set */
+static inline bool signalTake(ADLSignal * signal)
+{
+  if (signal->manual)
+    return atomic_load_explicit(&signal->state, memory_order_acquire) == 1;
+
+  unsigned int set = 1;
+  return atomic_compare_exchange_strong_explicit(&signal->state, &set, 0,
+      memory_order_acquire, memory_order_relaxed);
+}
+
+ADL_STATUS adlSignalWaitNS(ADLSignal * signal, int64_t timeoutNS)
+{
+  if (signalTake(signal))
+    return ADL_OK;
+
+  if (timeoutNS == 0)
+    return ADL_ERR_BUSY;
+
+  for(int i = 0; i < SYNC_SPIN; ++i)
+  {
+    adlCPURelax();
+    if (signalTake(signal))
+      return ADL_OK;
+  }
+
+  const uint64_t deadline = syncDeadline(timeoutNS);
+  for(;;)
+  {
+    const bool woken = syncSleep(&signal->state, 0, &signal->waiters,
+        deadline);
+    if (signalTake(signal))
+      return ADL_OK;
+
+    if (!woken)
+      return ADL_ERR_TIMEOUT;
+  }
+}
+
+ADL_STATUS adlSignalWait(ADLSignal * signal, int timeout)
+{
+  return adlSignalWaitNS(signal, msToNS(timeout));
+}
+
+void adlLatchInit(ADLLatch * latch, unsigned int count)
+{
+  atomic_init(&latch->count  , count);
+  atomic_init(&latch->waiters, 0);
+}
+
+void adlLatchCountDown(ADLLatch * latch, unsigned int n)
+{
+  unsigned int count = atomic_load_explicit(&latch->count,
+      memory_order_relaxed);
+  unsigned int next;
+  do
+  {
+    if (!count)
+      return;
+    next = n < count ? count - n : 0;
+  }
+  while(!atomic_compare_exchange_weak_explicit(&latch->count, &count, next,
+        memory_order_release, memory_order_relaxed));
+
+  if (!next)
+    syncWake(&latch->count, &latch->waiters, true);
+}
+
+ADL_STATUS adlLatchWaitNS(ADLLatch * latch, int64_t timeoutNS)
+{
+  unsigned int count = atomic_load_explicit(&latch->count,
+      memory_order_acquire);
+  if (!count)
+    return ADL_OK;
+
+  if (timeoutNS == 0)
+    return ADL_ERR_BUSY;
+
+  for(int i = 0; i < SYNC_SPIN; ++i)
+  {
+    adlCPURelax();
+    if (!(count = atomic_load_explicit(&latch->count, memory_order_acquire)))
+      return ADL_OK;
+  }
+
+  const uint64_t deadline = syncDeadline(timeoutNS);
+  for(;;)
+  {
+    const bool woken = syncSleep(&latch->count, count, &latch->waiters,
+        deadline);
+    if (!(count = atomic_load_explicit(&latch->count, memory_order_acquire)))
+      return ADL_OK;
+
+    if (!woken)
+      return ADL_ERR_TIMEOUT;
+  }
+}
+
+ADL_STATUS adlLatchWait(ADLLatch * latch, int timeout)
+{
+  return adlLatchWaitNS(latch, msToNS(timeout));
+}
@@ -0,0 +1,204 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "trace.h"
+#include "adl.h"
+
+#include "adl/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+/* spans kept per thread, older spans are overwritten */
+#define TRACE_BUFFER_SIZE 65536
+
+typedef struct
+{
+  const char * name;
+  unsigned int tid;
+  uint64_t     start;
+  uint64_t     end;
+}
+TraceEvent;
+
+typedef struct TraceBuffer
+{
+  struct TraceBuffer * next;
+  unsigned int         tid;
+  /* set once the owning thread has exited so another thread can take it */
+  atomic_bool          free;
+  /* the traceEpoch the spans belong to, only the owner writes it and count */
+  atomic_uint          epoch;
+  atomic_uint_fast64_t count;
+  TraceEvent           events[TRACE_BUFFER_SIZE];
+}
+TraceBuffer;
+
+atomic_bool adlTraceEnabled;
+
+/* buffers are never freed as the dump may be reading them, the buffer of a
+ * thread that exits is handed to the next thread that starts recording */
+static _Atomic(TraceBuffer *) traceBuffers;
+static atomic_uint            traceThreads;
+/* bumped by adlTraceStart, each owner discards its spans when it sees a new
+ * epoch so no other thread ever writes to its count */
+static atomic_uint            traceEpoch;
+static _Thread_local TraceBuffer * traceBuffer;
+
+static pthread_once_t traceKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t  traceKey;
+
+static void traceThreadExit(void * udata)
+{
+  TraceBuffer * buf = udata;
+  atomic_store_explicit(&buf->free, true, memory_order_release);
+}
+
+static void traceKeyCreate(void)
+{
+  pthread_key_create(&traceKey, traceThreadExit);
+}
+
+/* take the buffer of a thread that has exited or allocate a new one, the
+ * spans already in a reused buffer are kept, each span carries it's tid */
+static TraceBuffer * traceBufferGet(void)
+{
+  pthread_once(&traceKeyOnce, traceKeyCreate);
+
+  TraceBuffer * buf;
+  for(buf = atomic_load(&traceBuffers); buf; buf = buf->next)
+  {
+    bool expected = true;
+    if (atomic_compare_exchange_strong(&buf->free, &expected, false))
+      break;
+  }
+
+  if (!buf)
+  {
+    if (!(buf = calloc(1, sizeof(*buf))))
+      return NULL;
+
+    buf->next = atomic_load(&traceBuffers);
+    while(!atomic_compare_exchange_weak(&traceBuffers, &buf->next, buf)) {}
+  }
+
+  buf->tid = atomic_fetch_add(&traceThreads, 1) + 1;
+  pthread_setspecific(traceKey, buf);
+  return buf;
+}
+
+void adlTraceRecord(const char * name, uint64_t start, uint64_t end)
+{
+  TraceBuffer * buf = traceBuffer;
+  if (!buf)
+  {
+    if (!(buf = traceBufferGet()))
+      return;
+    traceBuffer = buf;
+  }
+
+  const unsigned int epoch =
+    atomic_load_explicit(&traceEpoch, memory_order_relaxed);
+  if (atomic_load_explicit(&buf->epoch, memory_order_relaxed) != epoch)
+  {
+    atomic_store_explicit(&buf->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&buf->epoch, epoch, memory_order_release);
+  }
+
+  const uint64_t n = atomic_load_explicit(&buf->count, memory_order_relaxed);
+  TraceEvent   * e = &buf->events[n % TRACE_BUFFER_SIZE];
+  e->name  = name;
+  e->tid   = buf->tid;
+  e->start = start;
+  e->end   = end;
+  atomic_store_explicit(&buf->count, n + 1, memory_order_release);
+}
+
+ADL_STATUS adlTraceStart(void)
+{
+  atomic_fetch_add(&traceEpoch, 1);
+  atomic_store(&adlTraceEnabled, true);
+  return ADL_OK;
+}
+
+ADL_STATUS adlTraceStop(void)
+{
+  atomic_store(&adlTraceEnabled, false);
+  return ADL_OK;
+}
+
+ADL_STATUS adlTraceDump(const char * path)
+{
+  ADL_NOT_NULL_CHECK(path);
+
+  FILE * fp = fopen(path, "w");
+  if (!fp)
+  {
+    ADL_ERROR(ADL_ERR_PLATFORM, "failed to open %s", path);
+    return ADL_ERR_PLATFORM;
+  }
+
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", fp);
+
+  const unsigned int epoch = atomic_load(&traceEpoch);
+
+  bool first = true;
+  for(TraceBuffer * buf = atomic_load(&traceBuffers); buf; buf = buf->next)
+  {
+    /* the owner has not recorded since the last start */
+    if (atomic_load_explicit(&buf->epoch, memory_order_acquire) != epoch)
+      continue;
+
+    const uint64_t count =
+      atomic_load_explicit(&buf->count, memory_order_acquire);
+    const uint64_t start =
+      count > TRACE_BUFFER_SIZE ? count - TRACE_BUFFER_SIZE : 0;
+
+    for(uint64_t i = start; i < count; ++i)
+    {
+      const TraceEvent * e = &buf->events[i % TRACE_BUFFER_SIZE];
+      fprintf(fp,
+          "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+          "\"ts\":%" PRIu64 ".%03u,\"dur\":%" PRIu64 ".%03u}",
+          first ? "" : ",", e->name, e->tid,
+          e->start / 1000, (unsigned)(e->start % 1000),
+          (e->end - e->start) / 1000, (unsigned)((e->end - e->start) % 1000));
+      first = false;
+    }
+  }
+
+  fputs("\n]}\n", fp);
+
+  const bool failed = ferror(fp);
+  if (fclose(fp) != 0 || failed)
+  {
+    ADL_ERROR(ADL_ERR_PLATFORM, "failed to write %s", path);
+    return ADL_ERR_PLATFORM;
+  }
+
+  return ADL_OK;
+}
@@ -0,0 +1,69 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_TRACE
+#define _H_SRC_TRACE
+
+#include "adl/util.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+extern atomic_bool adlTraceEnabled;
+
+typedef struct
+{
+  const char * name;
+  uint64_t     start;
+}
+ADLTraceSpan;
+
+void adlTraceRecord(const char * name, uint64_t start, uint64_t end);
+
+static inline void adlTraceSpanEnd(ADLTraceSpan * span)
+{
+  if (span->start)
+    adlTraceRecord(span->name, span->start, adlGetClockNS());
+}
+
+#define ADL_TRACE_ON \
+  __builtin_expect( \
+    atomic_load_explicit(&adlTraceEnabled, memory_order_relaxed), 0)
+
+/* record a span named `label` from here to the end of the enclosing scope, the
+ * start time is made odd so that zero can mean tracing was disabled */
+#define ADL_TRACE_SCOPE(label) \
+  ADLTraceSpan __attribute__((cleanup(adlTraceSpanEnd))) \
+    ADL_TRACE_VAR(__LINE__) = \
+    { \
+      .name  = (label), \
+      .start = ADL_TRACE_ON ? adlGetClockNS() | 1 : 0 \
+    }
+
+#define ADL_TRACE_VAR(line)  ADL_TRACE_VAR_(line)
+#define ADL_TRACE_VAR_(line) __traceSpan##line
+
+#endif
@@ -0,0 +1,280 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "upload.h"
+#include "image.h"
+#include "window.h"
+#include "adl.h"
+#include "adl/thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+struct ADLUpload
+{
+  ADLUpload * next;
+  ADLImage  * image;
+
+  /* the caller's buffer is copied here so it can be released before the
+   * frame is pushed, the push completes before the next frame is dequeued so
+   * one staging buffer is enough */
+  void * staging;
+
+  /* the queued frame, at most one per image */
+  bool             queued;
+  bool             busy;
+  const void     * buffer;
+  ADLImageSubmitFn fn;
+  void           * udata;
+};
+
+static struct
+{
+  bool            running;
+  ADLThread       thread;
+  pthread_mutex_t lock;
+  pthread_cond_t  work;
+  pthread_cond_t  idle;
+
+  ADLUpload * head;
+  ADLUpload * tail;
+}
+upload =
+{
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .work = PTHREAD_COND_INITIALIZER,
+  .idle = PTHREAD_COND_INITIALIZER
+};
+
+static void * uploadThread(ADLThread * thread, void * udata)
+{
+  pthread_mutex_lock(&upload.lock);
+  for(;;)
+  {
+    while(!upload.head && adlThreadIsRunning(thread))
+      pthread_cond_wait(&upload.work, &upload.lock);
+
+    if (!adlThreadIsRunning(thread))
+      break;
+
+    ADLUpload * u = upload.head;
+    upload.head = u->next;
+    if (!upload.head)
+      upload.tail = NULL;
+
+    u->next   = NULL;
+    u->queued = false;
+    u->busy   = true;
+
+    const void     * buffer  = u->buffer;
+    ADLImageSubmitFn fn      = u->fn;
+    void           * fnData  = u->udata;
+    void           * staging = u->staging;
+    pthread_mutex_unlock(&upload.lock);
+
+    const ADLImageItem * li = ADL_IMAGE_GET_ITEM(u->image);
+    {
+      ADL_TRACE_SCOPE("uploadCopy");
+      memcpy(staging, buffer, li->bufferSize);
+    }
+
+    if (fn)
+      fn(u->image, buffer, false, fnData);
+
+    windowLock(u->image->window);
+    ADL_STATUS status = imageUpdate(u->image, staging);
+    windowUnlock(u->image->window);
+    if (status == ADL_OK)
+    {
+      ADL_TRACE_SCOPE("uploadFlush");
+      status = adl.platform->flush();
+    }
+
+    if (status != ADL_OK)
+      ADL_ERROR(status, "failed to upload the image");
+
+    pthread_mutex_lock(&upload.lock);
+    u->busy = false;
+    pthread_cond_broadcast(&upload.idle);
+  }
+  pthread_mutex_unlock(&upload.lock);
+
+  return NULL;
+}
+
+static ADL_STATUS uploadNew(ADLImage * image, ADLUpload ** result)
+{
+  const ADLImageItem * li = ADL_IMAGE_GET_ITEM(image);
+
+  ADLUpload * u = calloc(1, sizeof(*u));
+  if (!u)
+    goto err_nomem;
+
+  u->image = image;
+  if (!(u->staging = malloc(li->bufferSize)))
+    goto err_free;
+
+  *result = u;
+  return ADL_OK;
+
+err_free:
+  free(u);
+err_nomem:
+  ADL_ERROR(ADL_ERR_NO_MEM, "failed to allocate the staging buffer");
+  return ADL_ERR_NO_MEM;
+}
+
+ADL_STATUS adlUploadSubmit(ADLImage * image, const void * buffer,
+    ADLImageSubmitFn fn, void * udata)
+{
+  ADL_STATUS status;
+  ADLImageItem * li = ADL_IMAGE_GET_ITEM(image);
+
+  /* under the lock so concurrent submits to one image create it once */
+  pthread_mutex_lock(&upload.lock);
+  if (!li->upload && (status = uploadNew(image, &li->upload)) != ADL_OK)
+  {
+    pthread_mutex_unlock(&upload.lock);
+    return status;
+  }
+
+  ADLUpload * u = li->upload;
+  if (!upload.running)
+  {
+    const ADLThreadAttr attr = { .name = "adl-upload" };
+    status = adlThreadCreateEx(uploadThread, NULL, &attr, &upload.thread,
+        NULL);
+    if (status != ADL_OK)
+    {
+      pthread_mutex_unlock(&upload.lock);
+      ADL_ERROR(status, "failed to start the upload thread");
+      return status;
+    }
+    upload.running = true;
+  }
+
+  /* a frame that has not been started yet is replaced by the new one */
+  const void     * dropBuffer = u->buffer;
+  ADLImageSubmitFn dropFn     = u->queued ? u->fn : NULL;
+  void           * dropData   = u->udata;
+
+  u->buffer = buffer;
+  u->fn     = fn;
+  u->udata  = udata;
+
+  if (!u->queued)
+  {
+    u->queued = true;
+    if (upload.tail)
+      upload.tail->next = u;
+    else
+      upload.head = u;
+    upload.tail = u;
+    pthread_cond_signal(&upload.work);
+  }
+  pthread_mutex_unlock(&upload.lock);
+
+  if (dropFn)
+    dropFn(image, dropBuffer, true, dropData);
+
+  return ADL_OK;
+}
+
+void adlUploadCancel(ADLImage * image)
+{
+  ADLImageItem * li = ADL_IMAGE_GET_ITEM(image);
+  ADLImageSubmitFn dropFn = NULL;
+
+  pthread_mutex_lock(&upload.lock);
+  ADLUpload * u = li->upload;
+  if (!u)
+  {
+    pthread_mutex_unlock(&upload.lock);
+    return;
+  }
+
+  if (u->queued)
+  {
+    ADLUpload ** p = &upload.head;
+    ADLUpload *  prev = NULL;
+    while(*p != u)
+    {
+      prev = *p;
+      p    = &(*p)->next;
+    }
+
+    *p = u->next;
+    if (upload.tail == u)
+      upload.tail = prev;
+
+    u->queued = false;
+    dropFn    = u->fn;
+  }
+
+  while(u->busy)
+    pthread_cond_wait(&upload.idle, &upload.lock);
+  li->upload = NULL;
+  pthread_mutex_unlock(&upload.lock);
+
+  if (dropFn)
+    dropFn(image, u->buffer, true, u->udata);
+
+  free(u->staging);
+  free(u);
+}
+
+void adlUploadShutdown(void)
+{
+  pthread_mutex_lock(&upload.lock);
+  if (!upload.running)
+  {
+    pthread_mutex_unlock(&upload.lock);
+    return;
+  }
+
+  adlThreadStop(&upload.thread);
+  pthread_cond_broadcast(&upload.work);
+  pthread_mutex_unlock(&upload.lock);
+
+  adlThreadJoin(&upload.thread, NULL, -1);
+
+  pthread_mutex_lock(&upload.lock);
+  ADLUpload * u = upload.head;
+  upload.head    = NULL;
+  upload.tail    = NULL;
+  upload.running = false;
+  pthread_mutex_unlock(&upload.lock);
+
+  while(u)
+  {
+    ADLUpload * next = u->next;
+    u->next   = NULL;
+    u->queued = false;
+    if (u->fn)
+      u->fn(u->image, u->buffer, true, u->udata);
+    u = next;
+  }
+}
@@ -0,0 +1,46 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_UPLOAD
+#define _H_SRC_UPLOAD
+
+#include "adl/image.h"
+
+/* per image state of the upload thread */
+typedef struct ADLUpload ADLUpload;
+
+/* queue the buffer to be uploaded and presented by the upload thread, the
+ * thread is started on first use */
+ADL_STATUS adlUploadSubmit(ADLImage * image, const void * buffer,
+    ADLImageSubmitFn fn, void * udata);
+
+/* drop any queued frame for the image, wait for the frame in progress and
+ * release the image's staging buffer */
+void adlUploadCancel(ADLImage * image);
+
+/* stop the upload thread dropping any queued frames */
+void adlUploadShutdown(void);
+
+#endif
@@ -0,0 +1,175 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "wheel.h"
+
+#include <string.h>
+
+#define SLOT_MASK (ADL_WHEEL_SLOTS - 1)
+
+static inline uint64_t rotr(uint64_t v, unsigned int n)
+{
+  return n ? (v >> n) | (v << (64 - n)) : v;
+}
+
+void adlWheelInit(ADLWheel * wheel, uint64_t now)
+{
+  memset(wheel, 0, sizeof(*wheel));
+  wheel->now = now;
+}
+
+static void slotLink(ADLWheel * wheel, unsigned int level, unsigned int slot,
+    ADLTimer * timer)
+{
+  ADLTimer ** head = &wheel->slots[level][slot];
+
+  timer->slot  = level * ADL_WHEEL_SLOTS + slot;
+  timer->next  = *head;
+  timer->pprev = head;
+  if (*head)
+    (*head)->pprev = &timer->next;
+  *head = timer;
+
+  wheel->occupied[level] |= 1ULL << slot;
+}
+
+void adlWheelInsert(ADLWheel * wheel, ADLTimer * timer)
+{
+  uint64_t expires = timer->expires;
+  if (expires < wheel->now)
+    expires = wheel->now;
+
+  /* the lowest level where the timer's slot is less than a full turn away,
+   * which also puts it at least one slot away on the levels above 0 */
+  for(unsigned int level = 0; level < ADL_WHEEL_LEVELS; ++level)
+  {
+    const unsigned int shift = level * ADL_WHEEL_BITS;
+    if ((expires >> shift) - (wheel->now >> shift) < ADL_WHEEL_SLOTS)
+    {
+      slotLink(wheel, level, (expires >> shift) & SLOT_MASK, timer);
+      return;
+    }
+  }
+
+  /* beyond the range of the wheel, park it in the furthest slot of the top
+   * level, it is reinserted when that slot cascades */
+  const unsigned int shift = (ADL_WHEEL_LEVELS - 1) * ADL_WHEEL_BITS;
+  slotLink(wheel, ADL_WHEEL_LEVELS - 1,
+      ((wheel->now >> shift) + SLOT_MASK) & SLOT_MASK, timer);
+}
+
+void adlWheelRemove(ADLWheel * wheel, ADLTimer * timer)
+{
+  if (!timer->pprev)
+    return;
+
+  *timer->pprev = timer->next;
+  if (timer->next)
+    timer->next->pprev = timer->pprev;
+
+  const unsigned int level = timer->slot / ADL_WHEEL_SLOTS;
+  const unsigned int slot  = timer->slot % ADL_WHEEL_SLOTS;
+  if (!wheel->slots[level][slot])
+    wheel->occupied[level] &= ~(1ULL << slot);
+
+  timer->next  = NULL;
+  timer->pprev = NULL;
+}
+
+uint64_t adlWheelNext(const ADLWheel * wheel)
+{
+  uint64_t next = UINT64_MAX;
+  for(unsigned int level = 0; level < ADL_WHEEL_LEVELS; ++level)
+  {
+    if (!wheel->occupied[level])
+      continue;
+
+    /* level 0 slots expire at their tick, the others cascade at the start of
+     * the range they cover */
+    const unsigned int shift = level * ADL_WHEEL_BITS;
+    const uint64_t     cur   = wheel->now >> shift;
+    const uint64_t     dist  = __builtin_ctzll(
+        rotr(wheel->occupied[level], cur & SLOT_MASK));
+
+    const uint64_t tick = (cur + dist) << shift;
+    if (tick < next)
+      next = tick;
+  }
+
+  return next;
+}
+
+/* detach a slot's timers, returning the list */
+static ADLTimer * slotTake(ADLWheel * wheel, unsigned int level,
+    unsigned int slot)
+{
+  ADLTimer * list = wheel->slots[level][slot];
+  wheel->slots[level][slot] = NULL;
+  wheel->occupied[level] &= ~(1ULL << slot);
+  return list;
+}
+
+void adlWheelAdvance(ADLWheel * wheel, uint64_t tick, ADLWheelExpireFn fn,
+    void * udata)
+{
+  uint64_t next;
+  while((next = adlWheelNext(wheel)) <= tick)
+  {
+    /* cascade the higher levels whose slot starts at this tick down */
+    for(unsigned int level = ADL_WHEEL_LEVELS - 1; level > 0; --level)
+    {
+      const unsigned int shift = level * ADL_WHEEL_BITS;
+      if (next & ((1ULL << shift) - 1))
+        continue;
+
+      ADLTimer * list = slotTake(wheel, level, (next >> shift) & SLOT_MASK);
+      wheel->now = next;
+      while(list)
+      {
+        ADLTimer * timer = list;
+        list         = timer->next;
+        timer->pprev = NULL;
+        adlWheelInsert(wheel, timer);
+      }
+    }
+
+    /* move the expired timers onto a local list so the callbacks are free to
+     * insert and remove timers, then step past this tick */
+    ADLTimer * expired = slotTake(wheel, 0, next & SLOT_MASK);
+    if (expired)
+      expired->pprev = &expired;
+    wheel->now = next + 1;
+
+    ADLTimer * timer;
+    while((timer = expired))
+    {
+      adlWheelRemove(wheel, timer);
+      fn(timer, udata);
+    }
+  }
+
+  if (wheel->now <= tick)
+    wheel->now = tick + 1;
+}
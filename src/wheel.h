@@ -0,0 +1,66 @@
+/*
+  MIT License
+
+  Copyright (c) 2020 Geoffrey McRae <geoff@hostfission.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef _H_SRC_WHEEL
+#define _H_SRC_WHEEL
+
+#include "adl/adl.h"
+
+#include <stdint.h>
+
+#define ADL_WHEEL_BITS   6
+#define ADL_WHEEL_SLOTS  (1 << ADL_WHEEL_BITS)
+#define ADL_WHEEL_LEVELS 4
+
+/* a hierarchical timer wheel of ADLTimers keyed by their `expires` tick
+ *
+ * level n slots span 64^n ticks, timers are placed in the lowest level that
+ * can hold them and cascade down a level as the wheel reaches their slot.
+ * Insert and remove are O(1), each slot is a list linked through the timers */
+typedef struct
+{
+  uint64_t   now; // the next tick to be processed
+  uint64_t   occupied[ADL_WHEEL_LEVELS];
+  ADLTimer * slots[ADL_WHEEL_LEVELS][ADL_WHEEL_SLOTS];
+}
+ADLWheel;
+
+typedef void (*ADLWheelExpireFn)(ADLTimer * timer, void * udata);
+
+void adlWheelInit(ADLWheel * wheel, uint64_t now);
+
+/* insert a timer, an `expires` tick in the past is treated as the next tick */
+void adlWheelInsert(ADLWheel * wheel, ADLTimer * timer);
+void adlWheelRemove(ADLWheel * wheel, ADLTimer * timer);
+
+/* the earliest tick the wheel needs processing at, UINT64_MAX if empty */
+uint64_t adlWheelNext(const ADLWheel * wheel);
+
+/* process all ticks up to and including `tick`, calling `fn` for each timer
+ * that expires after removing it. `fn` may insert and remove timers */
+void adlWheelAdvance(ADLWheel * wheel, uint64_t tick, ADLWheelExpireFn fn,
+    void * udata);
+
+#endif
@@ -26,41 +26,146 @@
 #include "src/window.h"
 #include "src/adl.h"
 #include "src/image.h"
+#include "src/event.h"
+#include "src/upload.h"
 
 #include "adl/event.h"
 
 #include <stdlib.h>
+#include <string.h>
 
-void windowListItemDestructor(ADLLinkedListItem * item)
+void windowFree(ADLWindowItem * item)
 {
-  ADLWindowListItem * wi = (ADLWindowListItem *)item;
+  ADLHandleTable * images = &item->images;
 
-  adlLinkedListFree(ADL_GET_WINDOW_IMAGE_LIST(&wi->window));
+  /* the upload thread takes the window lock, finish with it first */
+  for(uint32_t i = 0; i < images->count; ++i)
+  {
+    ADLImageItem * image = images->items[i];
+    adlUploadCancel(&image->image);
+  }
+
+  /* once removed the window can not be found by the event thread, taking the
+   * window lock then waits for any event that is still being processed */
+  adlWindowsLock(true);
+  adlHandleRemove(&adl.windows, item->handle);
+  adlWindowsUnlock();
+
+  windowLock(&item->window);
+  while(images->count)
+    imageFree(images->items[images->count - 1]);
+  adlHandleTableFree(images);
 
   ADL_STATUS status;
-  if ((status = adl.platform->windowDestroy(&wi->window)) != ADL_OK)
+  if ((status = adl.platform->windowDestroy(&item->window)) != ADL_OK)
     ADL_ERROR(status, "windowDestroy failed");
+  windowUnlock(&item->window);
+
+  eventQueueClear(&item->window);
+  pthread_mutex_destroy(&item->lock);
+
+  adlSlabLock();
+  adlSlabRelease(&adl.windowSlab, item);
+  adlSlabUnlock();
+}
+
+bool windowIsValid(ADLWindow * window)
+{
+  /* the window may have been freed, look for it without reading it */
+  adlWindowsLock(false);
+  const bool valid =
+    adlHandleContains(&adl.windows, ADL_WINDOW_GET_ITEM(window));
+  adlWindowsUnlock();
+  return valid;
+}
+
+ADLWindow * windowFindLocked(ADLWindowId id)
+{
+  /* lock the window before releasing the registry so it can not be freed */
+  adlWindowsLock(false);
+  ADLWindowItem * item = adlHandleFind(&adl.windows, id);
+  if (item)
+    windowLock(&item->window);
+  adlWindowsUnlock();
+  return item ? &item->window : NULL;
+}
+
+void windowLock(ADLWindow * window)
+{
+  if (adl.threadSafe)
+    pthread_mutex_lock(&ADL_WINDOW_GET_ITEM(window)->lock);
+}
 
-  free(wi);
+void windowUnlock(ADLWindow * window)
+{
+  if (adl.threadSafe)
+    pthread_mutex_unlock(&ADL_WINDOW_GET_ITEM(window)->lock);
 }
 
-bool windowListItemEvent(ADLLinkedListItem * item, void * udata)
+void windowPublishState(ADLWindow * window)
 {
-  ADLWindowListItem * wi = (ADLWindowListItem *)item;
-  adl.platform->windowEvent(&wi->window, (ADLEvent *)udata);
-  return true;
+  ADLWindowItem     * item = ADL_WINDOW_GET_ITEM(window);
+  ADLWindowStateSeq * seq  = &item->state;
+
+  /* there is only one writer so the sequence can't change under us */
+  const unsigned int s = atomic_load_explicit(&seq->seq, memory_order_relaxed);
+
+  uint32_t words[ADL_WINDOW_STATE_WORDS] = { 0 };
+  const ADLWindowState state =
+  {
+    .serial      = s / 2 + 1,
+    .x           = window->x,
+    .y           = window->y,
+    .w           = window->w,
+    .h           = window->h,
+    .visible     = window->visible,
+    .focused     = window->focused,
+    .havePointer = window->haveMousePos,
+    .pointerX    = window->mouseX,
+    .pointerY    = window->mouseY,
+    .buttons     = item->buttons
+  };
+  memcpy(words, &state, sizeof(state));
+
+  /* odd while the words are being written */
+  atomic_store_explicit(&seq->seq, s + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  for(unsigned int i = 0; i < ADL_WINDOW_STATE_WORDS; ++i)
+    atomic_store_explicit(&seq->words[i], words[i], memory_order_relaxed);
+
+  atomic_store_explicit(&seq->seq, s + 2, memory_order_release);
 }
 
-ADLWindow * windowFindById(ADLWindowId id)
+ADL_STATUS adlWindowGetState(ADLWindow * window, ADLWindowState * state)
 {
-  ADLLinkedListItem * item;
-  for(item = adl.windowList.head; item != NULL; item = item->next)
+  ADL_INITCHECK;
+  ADL_NOT_NULL_CHECK(window);
+  ADL_NOT_NULL_CHECK(state);
+
+  const ADLWindowStateSeq * seq = &ADL_WINDOW_GET_ITEM(window)->state;
+  uint32_t     words[ADL_WINDOW_STATE_WORDS];
+  unsigned int s;
+
+  for(;;)
   {
-    ADLWindowListItem * li = (ADLWindowListItem *)item;
-    if (ADL_GET_WINDOW_ID(&li->window) == id)
-      return &li->window;
+    s = atomic_load_explicit(&seq->seq, memory_order_acquire);
+    if (s & 1)
+    {
+      adlCPURelax();
+      continue;
+    }
+
+    for(unsigned int i = 0; i < ADL_WINDOW_STATE_WORDS; ++i)
+      words[i] = atomic_load_explicit(&seq->words[i], memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&seq->seq, memory_order_relaxed) == s)
+      break;
   }
-  return NULL;
+
+  memcpy(state, words, sizeof(*state));
+  return ADL_OK;
 }
 
 ADL_STATUS adlWindowCreate(const ADLWindowDef def, ADLWindow ** result)
@@ -76,19 +181,20 @@ ADL_STATUS adlWindowCreate(const ADLWindowDef def, ADLWindow ** result)
 
   *result = NULL;
 
-  ADLWindowListItem * item;
-  status = adlLinkedListNewItem(&adl.windowList, (ADLLinkedListItem **)&item);
+  ADLWindowItem * item;
+  adlSlabLock();
+  status = adlSlabAlloc(&adl.windowSlab, (void **)&item);
+  adlSlabUnlock();
   if (status != ADL_OK)
     return status;
 
-  /* initialize the image list */
-  if ((status = adlLinkedListNew(
-          sizeof(ADLImageListItem) + adl.platform->imageDataSize,
-          imageListItemDestructor, &item->imageList)) != ADL_OK)
-  {
-    adlLinkedListPop(&adl.windowList, NULL);
-    return status;
-  }
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&item->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  adlHandleTableNew(&item->images);
 
   ADLWindow * win = &item->window;
   win->parent = def.parent;
@@ -97,17 +203,46 @@ ADL_STATUS adlWindowCreate(const ADLWindowDef def, ADLWindow ** result)
   win->w      = def.w;
   win->h      = def.h;
 
-  status = adl.platform->windowCreate(def, win);
-  if (status == ADL_OK && (!ADL_GET_WINDOW_DATA(win)))
+  /* the window is only added to the registry once the platform has created
+   * it so that other threads never see it partially constructed */
   {
-    ADL_BUG(ADL_ERR_PLATFORM,
-        "%s->windowCreate did not set the window data", adl.platform->name);
+    ADL_TRACE_SCOPE("windowCreate");
+    status = adl.platform->windowCreate(def, win);
+  }
+  if (status != ADL_OK)
+    goto err_free;
 
-    adlLinkedListPop(&adl.windowList, NULL);
-    return ADL_ERR_PLATFORM;
+  if (!item->id)
+  {
+    ADL_BUG(ADL_ERR_PLATFORM,
+        "%s->windowCreate did not set the window id", adl.platform->name);
+    status = ADL_ERR_PLATFORM;
+    goto err_destroy;
   }
 
+  windowPublishState(win);
+
+  adlWindowsLock(true);
+  status = adlHandleAdd(&adl.windows, item, &item->handle);
+  if (status == ADL_OK &&
+      (status = adlHandleSetId(&adl.windows, item->handle, item->id)) != ADL_OK)
+    adlHandleRemove(&adl.windows, item->handle);
+  adlWindowsUnlock();
+
+  if (status != ADL_OK)
+    goto err_destroy;
+
   *result = win;
+  return ADL_OK;
+
+err_destroy:
+  adl.platform->windowDestroy(win);
+err_free:
+  adlHandleTableFree(&item->images);
+  pthread_mutex_destroy(&item->lock);
+  adlSlabLock();
+  adlSlabRelease(&adl.windowSlab, item);
+  adlSlabUnlock();
   return status;
 }
 
@@ -119,8 +254,8 @@ ADL_STATUS adlWindowDestroy(ADLWindow ** window)
   if (!*window)
     return ADL_OK;
 
-  ADLWindowListItem * li = ADL_WINDOW_GET_LIST_ITEM(*window);
-  adlLinkedListRemove(&adl.windowList, (ADLLinkedListItem **)&li, true);
+  ADL_WINDOW_CHECK(*window);
+  windowFree(ADL_WINDOW_GET_ITEM(*window));
 
   *window = NULL;
   return ADL_OK;
@@ -130,47 +265,82 @@ ADL_STATUS adlWindowShow(ADLWindow * window)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
-  return adl.platform->windowShow(window);
+  ADL_WINDOW_CHECK(window);
+
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->windowShow(window);
+  windowUnlock(window);
+  return status;
 }
 
 ADL_STATUS adlWindowHide(ADLWindow * window)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
-  return adl.platform->windowHide(window);
+  ADL_WINDOW_CHECK(window);
+
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->windowHide(window);
+  windowUnlock(window);
+  return status;
 }
 
 ADL_STATUS adlWindowSetClassName(ADLWindow * window, const char * className)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
-  return adl.platform->windowSetClassName(window, className);
+  ADL_WINDOW_CHECK(window);
+
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->windowSetClassName(window, className);
+  windowUnlock(window);
+  return status;
 }
 
 ADL_STATUS adlWindowSetTitle(ADLWindow * window, const char * title)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
-  return adl.platform->windowSetTitle(window, title);
+  ADL_WINDOW_CHECK(window);
+
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->windowSetTitle(window, title);
+  windowUnlock(window);
+  return status;
 }
 
 ADL_STATUS adlWindowSetGrab(ADLWindow * window, bool enable)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
-  return adl.platform->windowSetGrab(window, enable);
+  ADL_WINDOW_CHECK(window);
+
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->windowSetGrab(window, enable);
+  windowUnlock(window);
+  return status;
 }
 
 ADL_STATUS adlWindowSetRelative(ADLWindow * window, bool enable)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
-  return adl.platform->windowSetRelative(window, enable);
+  ADL_WINDOW_CHECK(window);
+
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->windowSetRelative(window, enable);
+  windowUnlock(window);
+  return status;
 }
 
 ADL_STATUS adlWindowSetFocus(ADLWindow * window)
 {
   ADL_INITCHECK;
   ADL_NOT_NULL_CHECK(window);
-  return adl.platform->windowSetFocus(window);
+  ADL_WINDOW_CHECK(window);
+
+  windowLock(window);
+  const ADL_STATUS status = adl.platform->windowSetFocus(window);
+  windowUnlock(window);
+  return status;
 }
@@ -25,41 +25,82 @@
 #ifndef _H_SRC_WINDOW
 #define _H_SRC_WINDOW
 
-#include "linkedlist.h"
+#include "handle.h"
 #include "adl/window.h"
 
 #include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 typedef uint64_t ADLWindowId;
 
+#define ADL_WINDOW_STATE_WORDS \
+  ((sizeof(ADLWindowState) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+
+/* the published ADLWindowState, a seqlock with the event thread as the only
+ * writer, the state is copied through atomic words so readers never race */
 typedef struct
 {
-  ADLLinkedListItem item;
+  atomic_uint seq;
+  atomic_uint words[ADL_WINDOW_STATE_WORDS];
+}
+ADLWindowStateSeq;
 
+typedef struct
+{
   ADLWindowId       id;
+  ADLHandle         handle;
+  pthread_mutex_t   lock;
   ADLWindow         window;
-  ADLLinkedList     imageList;
+  ADLHandleTable    images;
+
+  // owned by the event thread
+  unsigned int      buttons;
+  ADLWindowStateSeq state;
 }
-ADLWindowListItem;
+ADLWindowItem;
 
-#define ADL_WINDOW_GET_LIST_ITEM(x) \
-  ((ADLWindowListItem *)(((uint8_t*)ADL_CHECK_TYPE(ADLWindow *, x)) - \
-     offsetof(ADLWindowListItem, window)))
+#define ADL_WINDOW_GET_ITEM(x) \
+  ((ADLWindowItem *)(((uint8_t*)ADL_CHECK_TYPE(ADLWindow *, x)) - \
+     offsetof(ADLWindowItem, window)))
 
 #define ADL_SET_WINDOW_ID(x, v) \
-  ADL_WINDOW_GET_LIST_ITEM(x)->id = v
+  ADL_WINDOW_GET_ITEM(x)->id = v
 
 #define ADL_GET_WINDOW_ID(x) \
-  ADL_WINDOW_GET_LIST_ITEM(x)->id
+  ADL_WINDOW_GET_ITEM(x)->id
 
 #define ADL_GET_WINDOW_DATA(x) \
-  ((void *)(ADL_WINDOW_GET_LIST_ITEM(x)+1))
+  ((void *)(ADL_WINDOW_GET_ITEM(x)+1))
+
+#define ADL_GET_WINDOW_IMAGES(x) \
+  (&(ADL_WINDOW_GET_ITEM(x)->images))
+
+/* debug builds reject windows that have already been destroyed */
+#ifndef NDEBUG
+#define ADL_WINDOW_CHECK(x) \
+  if (!windowIsValid(x)) \
+  { \
+    ADL_BUG(ADL_ERR_INVALID_ARGUMENT, #x " is not a valid window"); \
+    return ADL_ERR_INVALID_ARGUMENT; \
+  }
+#else
+#define ADL_WINDOW_CHECK(x)
+#endif
+
+void windowFree(ADLWindowItem * item);
+bool windowIsValid(ADLWindow * window);
+
+/* find the window and return it locked, release it with windowUnlock */
+ADLWindow * windowFindLocked(ADLWindowId id);
 
-#define ADL_GET_WINDOW_IMAGE_LIST(x) \
-  (&(ADL_WINDOW_GET_LIST_ITEM(x)->imageList))
+/* serialize the platform calls for a window in thread-safe mode, the lock is
+ * recursive so the platform may call back into ADL for the same window */
+void windowLock(ADLWindow * window);
+void windowUnlock(ADLWindow * window);
 
-void windowListItemDestructor(ADLLinkedListItem * item);
-bool windowListItemEvent(ADLLinkedListItem * item, void * udata);
-ADLWindow * windowFindById(ADLWindowId id);
+/* publish the window's current state for adlWindowGetState, only called from
+ * the event thread */
+void windowPublishState(ADLWindow * window);
 
 #endif